@@ -0,0 +1,36 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include <algorithm>
+#include <chrono>
+#include <limits>
+
+namespace GainStage
+{
+    namespace Benchmarks
+    {
+        // Fastest of several timed runs of `calls` calls to body, in nanoseconds per call.
+        // Taking the minimum filters out preemption and frequency ramps.
+        template <typename Body>
+        double timeBestOf(int runs, int calls, Body&& body)
+        {
+            double best = std::numeric_limits<double>::max();
+
+            for (int run = 0; run < runs; ++run)
+            {
+                const auto start = std::chrono::steady_clock::now();
+
+                for (int call = 0; call < calls; ++call)
+                    body();
+
+                const std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+                best = std::min(best, elapsed.count() / calls);
+            }
+
+            return best;
+        }
+
+        void runChannelScaling();
+        void runContention();
+    }
+}
@@ -0,0 +1,76 @@
+#include "Benchmark.h"
+#include "../Source/GainAnalyzer.h"
+#include "../Source/SharedBuffer.h"
+
+#include <cstdio>
+
+namespace GainStage
+{
+    namespace Benchmarks
+    {
+        // Per-channel cost of the analyzer and of a ring write plus read as the channel count
+        // grows. Storage is planar, so nanoseconds per channel-sample should stay flat.
+        void runChannelScaling()
+        {
+            constexpr double sampleRate = 48000.0;
+            constexpr int blockSize = 512;
+            constexpr int numBlocks = 2000;
+            constexpr int numRuns = 5;
+            constexpr int pairID = kMaxPairIDs;
+
+            auto& transport = SharedBufferManager::getInstance();
+            juce::Random random(1);
+
+            std::printf("Channel scaling, %d-sample blocks, ns per channel-sample (best of %d)\n", blockSize, numRuns);
+            std::printf("%8s %12s %12s\n", "channels", "analyzer", "ring");
+
+            double firstAnalyzer = 0.0, firstRing = 0.0, lastAnalyzer = 0.0, lastRing = 0.0;
+
+            for (int numChannels : { 1, 2, 4, 6, 8, 12, 16 })
+            {
+                juce::AudioBuffer<float> block(numChannels, blockSize);
+                juce::AudioBuffer<float> reference(numChannels, blockSize);
+
+                for (int ch = 0; ch < numChannels; ++ch)
+                    for (int i = 0; i < blockSize; ++i)
+                        block.setSample(ch, i, random.nextFloat() * 2.0f - 1.0f);
+
+                GainAnalyzer analyzer;
+                analyzer.prepare(sampleRate, blockSize, numChannels, kAnalyzerBinSize, kMaxRMSWindowSeconds);
+                analyzer.setRMSWindowSamples(rmsWindowToSamples(RMSWindow::Ms300, sampleRate));
+
+                const double analyzerNs = timeBestOf(numRuns, numBlocks, [&] { analyzer.process(block); });
+
+                transport.acquirePair(pairID);
+                transport.prepareBuffer(pairID, numChannels, getRequiredRingSize(sampleRate, blockSize, 0));
+                const int slot = transport.registerReader(pairID);
+                transport.setReaderNeedsAudio(pairID, slot, true);
+
+                const double ringNs = timeBestOf(numRuns, numBlocks, [&]
+                {
+                    transport.writeSamples(pairID, block, blockSize);
+                    transport.readSamples(pairID, reference, blockSize, 0, kNoTimelinePosition, slot);
+                });
+
+                transport.unregisterReader(pairID, slot);
+                transport.releasePair(pairID);
+
+                const double channelSamples = static_cast<double>(numChannels) * blockSize;
+                lastAnalyzer = analyzerNs / channelSamples;
+                lastRing = ringNs / channelSamples;
+
+                if (numChannels == 1)
+                {
+                    firstAnalyzer = lastAnalyzer;
+                    firstRing = lastRing;
+                }
+
+                std::printf("%8d %12.3f %12.3f\n", numChannels, lastAnalyzer, lastRing);
+            }
+
+            // 1.0 is perfectly linear; below 1.0 the fixed per-block cost is being amortised.
+            std::printf("16 ch / 1 ch per-channel cost: analyzer %.2f, ring %.2f\n\n",
+                        lastAnalyzer / firstAnalyzer, lastRing / firstRing);
+        }
+    }
+}
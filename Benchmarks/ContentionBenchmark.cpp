@@ -0,0 +1,152 @@
+#include "Benchmark.h"
+#include "../Source/SharedBuffer.h"
+
+#include <cstdio>
+#include <memory>
+#include <thread>
+
+namespace GainStage
+{
+    namespace Benchmarks
+    {
+        // The writer's and one reader's per-block atomics, as PairControl and ReaderSlot lay
+        // them out or packed into one cache line the way the control block used to be.
+        struct WriterFields
+        {
+            std::atomic<uint64_t>& writePosition;
+            std::atomic<uint64_t>& writeSequence;
+            std::atomic<uint64_t>& blocksWritten;
+        };
+
+        struct ReaderFields
+        {
+            std::atomic<uint64_t>& cursor;
+            std::atomic<uint64_t>& readerBlocks;
+            std::atomic<uint64_t>& audioReads;
+        };
+
+        struct alignas(kCacheLineSize) PackedPair
+        {
+            std::atomic<uint64_t> writePosition{ 0 };
+            std::atomic<uint64_t> writeSequence{ 0 };
+            std::atomic<uint64_t> blocksWritten{ 0 };
+            std::atomic<uint64_t> cursor{ 0 };
+            std::atomic<uint64_t> readerBlocks{ 0 };
+            std::atomic<uint64_t> audioReads{ 0 };
+
+            WriterFields getWriter() { return { writePosition, writeSequence, blocksWritten }; }
+            ReaderFields getReader() { return { cursor, readerBlocks, audioReads }; }
+        };
+
+        static WriterFields getWriter(PairControl& control)
+        {
+            return { control.writePosition, control.writeSequence, control.statsBlocksWritten };
+        }
+
+        static ReaderFields getReader(PairControl& control)
+        {
+            auto& reader = control.readers[0];
+            return { reader.cursor, reader.readerBlocks, reader.audioReads };
+        }
+
+        // The stores RingProtocol::write and writeStats make per block, without the copy.
+        static void writeBlock(WriterFields writer)
+        {
+            const uint64_t sequence = writer.writeSequence.load(std::memory_order_relaxed);
+            writer.writeSequence.store(sequence + 1, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_release);
+            writer.writePosition.store(writer.writePosition.load(std::memory_order_relaxed) + 512, std::memory_order_release);
+            writer.writeSequence.store(sequence + 2, std::memory_order_release);
+            writer.blocksWritten.store(writer.blocksWritten.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+        }
+
+        // What a reader's block does to the pair: check the writer, then its own bookkeeping.
+        static void readBlock(WriterFields writer, ReaderFields reader)
+        {
+            const uint64_t writePos = writer.writePosition.load(std::memory_order_acquire);
+            juce::ignoreUnused(writer.writeSequence.load(std::memory_order_acquire));
+
+            reader.cursor.store(writePos, std::memory_order_relaxed);
+            reader.readerBlocks.store(reader.readerBlocks.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+            reader.audioReads.store(reader.audioReads.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        }
+
+        // timeBestOf(body) while background runs in a loop on a second thread.
+        template <typename Body, typename Background>
+        static double timeAgainst(int runs, int calls, Body&& body, Background&& background)
+        {
+            std::atomic<bool> started{ false };
+            std::atomic<bool> running{ true };
+
+            std::thread thread([&]
+            {
+                started.store(true);
+
+                while (running.load(std::memory_order_relaxed))
+                    background();
+            });
+
+            while (! started.load())
+                std::this_thread::yield();
+
+            const double ns = timeBestOf(runs, calls, body);
+
+            running.store(false);
+            thread.join();
+            return ns;
+        }
+
+        // Cost of the writer's per-block stores while another core works on the same pair (its
+        // reader) or on a neighbouring pair (that pair's writer). With writer, reader and pair
+        // state on separate lines only the reader's loads of writer state cross cores; packed,
+        // every store does. Needs at least two cores to mean anything.
+        void runContention()
+        {
+            constexpr int numCalls = 2000000;
+            constexpr int numRuns = 5;
+
+            std::printf("Control-block contention, ns per writer block (best of %d, %u hardware threads)\n",
+                        numRuns, std::thread::hardware_concurrency());
+            std::printf("%-22s %10s %10s\n", "", "padded", "packed");
+
+            auto padded = std::make_unique<std::array<PairControl, 2>>();
+            auto packed = std::make_unique<PackedPair>();
+
+            // Two pairs packed back to back, as neighbouring slots of a plain array.
+            struct alignas(kCacheLineSize) NeighbourPairs
+            {
+                std::atomic<uint64_t> writePosition[2]{};
+                std::atomic<uint64_t> writeSequence[2]{};
+                std::atomic<uint64_t> blocksWritten[2]{};
+
+                WriterFields getWriter(int pair) { return { writePosition[pair], writeSequence[pair], blocksWritten[pair] }; }
+            };
+            auto neighbours = std::make_unique<NeighbourPairs>();
+
+            const double idlePadded = timeBestOf(numRuns, numCalls, [&] { writeBlock(getWriter((*padded)[0])); });
+            const double idlePacked = timeBestOf(numRuns, numCalls, [&] { writeBlock(packed->getWriter()); });
+            std::printf("%-22s %10.2f %10.2f\n", "alone", idlePadded, idlePacked);
+
+            const double readerPadded = timeAgainst(numRuns, numCalls,
+                                                    [&] { writeBlock(getWriter((*padded)[0])); },
+                                                    [&] { readBlock(getWriter((*padded)[0]), getReader((*padded)[0])); });
+            const double readerPacked = timeAgainst(numRuns, numCalls,
+                                                    [&] { writeBlock(packed->getWriter()); },
+                                                    [&] { readBlock(packed->getWriter(), packed->getReader()); });
+            std::printf("%-22s %10.2f %10.2f\n", "with its reader", readerPadded, readerPacked);
+
+            const double neighbourPadded = timeAgainst(numRuns, numCalls,
+                                                       [&] { writeBlock(getWriter((*padded)[0])); },
+                                                       [&] { writeBlock(getWriter((*padded)[1])); });
+            const double neighbourPacked = timeAgainst(numRuns, numCalls,
+                                                       [&] { writeBlock(neighbours->getWriter(0)); },
+                                                       [&] { writeBlock(neighbours->getWriter(1)); });
+            std::printf("%-22s %10.2f %10.2f\n", "with another pair", neighbourPadded, neighbourPacked);
+
+            if (std::thread::hardware_concurrency() < 2)
+                std::printf("Only one hardware thread: the contended rows measure time slicing, not cache traffic.\n");
+
+            std::printf("\n");
+        }
+    }
+}
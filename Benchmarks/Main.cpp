@@ -0,0 +1,28 @@
+#include <JuceHeader.h>
+#include "Benchmark.h"
+
+// Runs every benchmark, or only those named on the command line ("channels", "contention").
+int main(int argc, char* argv[])
+{
+    juce::ScopedJuceInitialiser_GUI juceInitialiser;
+
+    const auto wants = [argc, argv](const char* name)
+    {
+        if (argc < 2)
+            return true;
+
+        for (int i = 1; i < argc; ++i)
+            if (std::strcmp(argv[i], name) == 0)
+                return true;
+
+        return false;
+    };
+
+    if (wants("channels"))
+        GainStage::Benchmarks::runChannelScaling();
+
+    if (wants("contention"))
+        GainStage::Benchmarks::runContention();
+
+    return 0;
+}
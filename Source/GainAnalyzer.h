@@ -1,31 +1,130 @@
 #pragma once
 
 #include <JuceHeader.h>
+#include <array>
 #include <vector>
 #include <cmath>
+#include <cstdint>
+#include <utility>
+#include "RealtimeMemory.h"
+#include "LevelKernels.h"
 
 namespace GainStage
 {
+    // Windowed RMS and held peak per channel, with channel-planar history of per-bin energy.
+    // Windows are whole bins, so the far edge always falls on a bin boundary; the bin still
+    // filling is added sample-exactly on top. The window sum is kept running and replaced every
+    // window by one built from additions only, so rounding can't drift.
     class GainAnalyzer
     {
     public:
+        enum class Detector
+        {
+            Window,
+            // One-pole mean square with a time constant of half the window.
+            Exponential
+        };
+
         GainAnalyzer() = default;
 
-        void prepare(double sampleRate, int maxBlockSize)
+        // The history is only allocated, and locked in memory, for the Window detector.
+        void prepare(double sampleRate, int maxBlockSize, int numChannels = 2, int binSize = 1,
+                     double maxWindowSeconds = 0.5, Detector detector = Detector::Window)
         {
+            juce::ignoreUnused(maxBlockSize);
+
             sampleRate_ = sampleRate;
-            rmsBuffer_.resize(static_cast<size_t>(sampleRate * 0.5), 0.0f);
+            detector_ = detector;
+            numChannels_ = juce::jmax(1, numChannels);
+            binSize_ = juce::jmax(1, binSize);
+            maxWindowLength_ = juce::jmax(1, (static_cast<int>(sampleRate * maxWindowSeconds) + binSize_ - 1) / binSize_);
+
+            // The longest window's bins plus the one being written.
+            historySize_ = maxWindowLength_ + 1;
+            historyStride_ = (historySize_ + kHistoryAlignment - 1) / kHistoryAlignment * kHistoryAlignment;
+
+            if (detector_ == Detector::Window)
+                allocateHistory();
+            else
+                releaseHistory();
+
             rmsWritePos_ = 0;
             currentRMS_ = 0.0f;
             currentPeak_ = 0.0f;
             peakHoldCounter_ = 0;
+            channels_.assign(static_cast<size_t>(numChannels_), ChannelState{});
+            windowLength_ = getWindowLengthFor(rmsWindowSamples_);
+            rmsWindowSamples_ = windowLength_ * binSize_;
+            freshCount_ = 0;
+            binFill_ = 0;
+            updateExponentialCoefficients();
         }
 
+        // Rounded to whole bins. Every window shares the history, so a change just re-sums it.
         void setRMSWindowSamples(int samples)
         {
-            rmsWindowSamples_ = juce::jlimit(1, static_cast<int>(rmsBuffer_.size()), samples);
+            const int windowLength = getWindowLengthFor(samples);
+
+            if (windowLength == windowLength_)
+                return;
+
+            windowLength_ = windowLength;
+            rmsWindowSamples_ = windowLength * binSize_;
+
+            if (detector_ == Detector::Window)
+                reanchor();
+
+            updateExponentialCoefficients();
+        }
+
+        // Continues from the current level; going back to Window refills the history. Never
+        // allocates, so Window is refused until allocateHistory() has run.
+        bool setDetector(Detector detector)
+        {
+            if (detector == detector_)
+                return true;
+
+            if (detector == Detector::Window && ! hasHistory())
+                return false;
+
+            for (int ch = 0; ch < numChannels_; ++ch)
+            {
+                auto& state = channels_[static_cast<size_t>(ch)];
+
+                if (detector == Detector::Exponential)
+                    state.meanSquare = juce::jmax(0.0, getWindowEnergy(ch)) / getWindowSamples();
+                else
+                    seedHistory(ch, state.meanSquare);
+            }
+
+            freshCount_ = 0;
+            detector_ = detector;
+            return true;
         }
 
+        Detector getDetector() const { return detector_; }
+        bool hasHistory() const { return history_ != nullptr; }
+
+        // Off the audio thread, and never while process() may be using the Window detector.
+        void allocateHistory()
+        {
+            historyLock_.release();
+            rmsBuffer_.assign(static_cast<size_t>(historyStride_) * static_cast<size_t>(numChannels_) + kHistoryAlignment, 0.0f);
+            history_ = alignHistory(rmsBuffer_.data());
+            historyLock_ = RealtimeMemory::LockedRegion(rmsBuffer_.data(), rmsBuffer_.size() * sizeof(float));
+        }
+
+        void releaseHistory()
+        {
+            historyLock_.release();
+            history_ = nullptr;
+            std::vector<float>().swap(rmsBuffer_);
+        }
+
+        int getHistorySize() const { return historySize_; }
+        int getBinSize() const { return binSize_; }
+        int getRMSWindowSamples() const { return rmsWindowSamples_; }
+
         void setPeakHoldSamples(int samples)
         {
             peakHoldSamples_ = samples;
@@ -33,78 +132,454 @@ namespace GainStage
 
         void process(const juce::AudioBuffer<float>& buffer)
         {
-            const int numChannels = buffer.getNumChannels();
-            const int numSamples = buffer.getNumSamples();
+            process(buffer, buffer.getNumSamples());
+        }
 
-            float blockPeak = 0.0f;
-            double blockSumSquares = 0.0;
+        void process(const juce::AudioBuffer<float>& buffer, int numSamples)
+        {
+            const int numChannels = juce::jmin(buffer.getNumChannels(), numChannels_);
+            numSamples = juce::jmin(numSamples, buffer.getNumSamples());
+            process(buffer.getArrayOfReadPointers(), buffer.getArrayOfReadPointers(), numChannels, numSamples, numSamples);
+        }
+
+        // Each channel in two runs, as it sits in a ring buffer.
+        void process(const float* const* first, const float* const* second, int numChannels, int firstLength, int numSamples)
+        {
+            numChannels = juce::jmin(numChannels, numChannels_);
+            firstLength = juce::jmin(firstLength, numSamples);
+
+            int writePos = rmsWritePos_, freshCount = freshCount_, binFill = binFill_;
+
+            for (int ch = 0; ch < numChannels; ++ch)
+            {
+                auto& state = channels_[static_cast<size_t>(ch)];
+                WindowState window{ getChannelHistory(ch), rmsWritePos_, freshCount_, state.windowSum, state.freshSum };
+
+                float channelBlockPeak = 0.0f;
+                double channelBlockSum = 0.0;
+
+                if (detector_ == Detector::Exponential)
+                {
+                    for (auto [data, length] : { std::make_pair(first[ch], firstLength),
+                                                 std::make_pair(second[ch], numSamples - firstLength) })
+                    {
+                        const auto levels = kernels_->measure(data, length);
+                        channelBlockSum += levels.sumSquares;
+                        channelBlockPeak = juce::jmax(channelBlockPeak, levels.peak);
+                        state.meanSquare = decayRun(data, length, state.meanSquare);
+                    }
+                }
+                else if (binSize_ == 1)
+                {
+                    storeRun(first[ch], firstLength, window, channelBlockSum, channelBlockPeak);
+                    storeRun(second[ch], numSamples - firstLength, window, channelBlockSum, channelBlockPeak);
+                }
+                else
+                {
+                    binFill = binFill_;
+
+                    for (auto [data, length] : { std::make_pair(first[ch], firstLength),
+                                                 std::make_pair(second[ch], numSamples - firstLength) })
+                    {
+                        accumulateBins(length, window, state.binEnergy, binFill, [&, data = data](int offset, int count)
+                        {
+                            const auto levels = kernels_->measure(data + offset, count);
+                            channelBlockSum += levels.sumSquares;
+                            channelBlockPeak = juce::jmax(channelBlockPeak, levels.peak);
+                            return levels.sumSquares;
+                        });
+                    }
+                }
+
+                state.windowSum = window.sum;
+                state.freshSum = window.freshSum;
+                writePos = window.pos;
+                freshCount = window.freshCount;
+
+                state.blockSumSquares = static_cast<float>(channelBlockSum);
+                state.blockPeak = channelBlockPeak;
+            }
+
+            rmsWritePos_ = writePos;
+            freshCount_ = freshCount;
+            binFill_ = binFill;
+            finishBlock(numChannels, numSamples);
+        }
+
+        // Per-block statistics instead of audio; exact when the window spans whole blocks.
+        void processStats(const float* sumSquares, const float* peaks, int numChannels, int numSamples)
+        {
+            numChannels = juce::jmin(numChannels, numChannels_);
+            if (numSamples <= 0)
+                return;
+
+            const bool perSample = detector_ == Detector::Window && binSize_ == 1;
+            const bool fillsWindow = perSample && numSamples >= rmsWindowSamples_;
+            const double blockDecay = std::pow(expDecay_[1], numSamples);
+            const int numToFill = juce::jmin(numSamples, historySize_);
+            const int start = (rmsWritePos_ + numSamples - numToFill) % historySize_;
+            const int firstRun = juce::jmin(numToFill, historySize_ - start);
+            int writePos = perSample ? (rmsWritePos_ + numSamples) % historySize_ : rmsWritePos_;
+            int freshCount = fillsWindow ? 0 : freshCount_;
+            int binFill = binFill_;
 
             for (int ch = 0; ch < numChannels; ++ch)
             {
-                const float* data = buffer.getReadPointer(ch);
+                auto& state = channels_[static_cast<size_t>(ch)];
+                float* history = getChannelHistory(ch);
+                const float meanSquare = sumSquares[ch] / static_cast<float>(numSamples);
+
+                if (detector_ == Detector::Exponential)
+                {
+                    state.meanSquare = blockDecay * state.meanSquare + (1.0 - blockDecay) * meanSquare;
+                }
+                else if (fillsWindow)
+                {
+                    juce::FloatVectorOperations::fill(history + start, meanSquare, firstRun);
+                    if (numToFill > firstRun)
+                        juce::FloatVectorOperations::fill(history, meanSquare, numToFill - firstRun);
 
-                for (int i = 0; i < numSamples; ++i)
+                    state.windowSum = static_cast<double>(meanSquare) * rmsWindowSamples_;
+                    state.freshSum = 0.0;
+                }
+                else if (binSize_ == 1)
+                {
+                    WindowState window{ history, rmsWritePos_, freshCount_, state.windowSum, state.freshSum };
+
+                    for (int remaining = numSamples; remaining > 0;)
+                    {
+                        const int leaving = window.getLeavingPosition(windowLength_, historySize_);
+                        const int length = window.getRunLength(remaining, leaving, windowLength_, historySize_);
+                        const double leavingSum = kernels_->sum(history + leaving, length);
+
+                        juce::FloatVectorOperations::fill(history + window.pos, meanSquare, length);
+                        window.commit(length, static_cast<double>(meanSquare) * length, leavingSum,
+                                      windowLength_, historySize_);
+                        remaining -= length;
+                    }
+
+                    state.windowSum = window.sum;
+                    state.freshSum = window.freshSum;
+                    freshCount = window.freshCount;
+                }
+                else
                 {
-                    const float sample = data[i];
-                    const float absSample = std::abs(sample);
+                    WindowState window{ history, rmsWritePos_, freshCount_, state.windowSum, state.freshSum };
+                    binFill = binFill_;
 
-                    blockPeak = juce::jmax(blockPeak, absSample);
-                    blockSumSquares += static_cast<double>(sample * sample);
+                    accumulateBins(numSamples, window, state.binEnergy, binFill,
+                                   [meanSquare](int, int count) { return static_cast<double>(meanSquare) * count; });
 
-                    rmsBuffer_[rmsWritePos_] = sample * sample;
-                    rmsWritePos_ = (rmsWritePos_ + 1) % rmsBuffer_.size();
+                    state.windowSum = window.sum;
+                    state.freshSum = window.freshSum;
+                    writePos = window.pos;
+                    freshCount = window.freshCount;
                 }
+
+                state.blockSumSquares = sumSquares[ch];
+                state.blockPeak = peaks[ch];
             }
 
-            if (blockPeak >= currentPeak_)
+            rmsWritePos_ = writePos;
+            freshCount_ = freshCount;
+            binFill_ = binFill;
+            finishBlock(numChannels, numSamples);
+        }
+
+        float getBlockSumSquares(int channel) const
+        {
+            return juce::isPositiveAndBelow(channel, numChannels_) ? channels_[static_cast<size_t>(channel)].blockSumSquares : 0.0f;
+        }
+
+        float getBlockPeak(int channel) const
+        {
+            return juce::isPositiveAndBelow(channel, numChannels_) ? channels_[static_cast<size_t>(channel)].blockPeak : 0.0f;
+        }
+
+        int getNumChannels() const { return numChannels_; }
+
+        float getRMSLevel() const { return currentRMS_; }
+        float getPeakLevel() const { return currentPeak_; }
+
+        float getChannelRMSLevel(int channel) const
+        {
+            return juce::isPositiveAndBelow(channel, numChannels_) ? channels_[static_cast<size_t>(channel)].rms : 0.0f;
+        }
+
+        float getChannelPeakLevel(int channel) const
+        {
+            return juce::isPositiveAndBelow(channel, numChannels_) ? channels_[static_cast<size_t>(channel)].peak : 0.0f;
+        }
+
+        float getRMSdB() const { return toDecibels(currentRMS_); }
+        float getPeakdB() const { return toDecibels(currentPeak_); }
+        float getChannelRMSdB(int channel) const { return toDecibels(getChannelRMSLevel(channel)); }
+        float getChannelPeakdB(int channel) const { return toDecibels(getChannelPeakLevel(channel)); }
+
+    private:
+        // 64 bytes, in floats.
+        static constexpr int kHistoryAlignment = 16;
+
+        struct alignas(64) ChannelState
+        {
+            double windowSum = 0.0;
+            double freshSum = 0.0;
+            float rms = 0.0f;
+            float peak = 0.0f;
+            float blockSumSquares = 0.0f;
+            float blockPeak = 0.0f;
+            int peakHoldCounter = 0;
+            double binEnergy = 0.0;
+            double meanSquare = 0.0;
+        };
+
+        static constexpr int kExponentialChunk = 64;
+
+        static float* alignHistory(float* data)
+        {
+            constexpr auto alignment = static_cast<uintptr_t>(kHistoryAlignment) * sizeof(float);
+            const auto address = reinterpret_cast<uintptr_t>(data);
+            return reinterpret_cast<float*>((address + alignment - 1) & ~(alignment - 1));
+        }
+
+        static float toDecibels(float level)
+        {
+            return (level > 0.0f) ? 20.0f * std::log10(level) : -100.0f;
+        }
+
+        int getWindowLengthFor(int samples) const
+        {
+            return juce::jlimit(1, maxWindowLength_, juce::roundToInt(static_cast<double>(samples) / binSize_));
+        }
+
+        // The whole bins plus the samples of the one still filling.
+        int getWindowSamples() const
+        {
+            return rmsWindowSamples_ + binFill_;
+        }
+
+        // Null without a history, which only the Exponential detector runs with.
+        float* getChannelHistory(int channel)
+        {
+            return history_ != nullptr ? history_ + static_cast<size_t>(channel) * static_cast<size_t>(historyStride_) : nullptr;
+        }
+
+        struct WindowState
+        {
+            float* history;
+            int pos;
+            int freshCount;
+            double sum;
+            double freshSum;
+
+            int getLeavingPosition(int windowSize, int historySize) const
             {
-                currentPeak_ = blockPeak;
-                peakHoldCounter_ = peakHoldSamples_;
+                const int leaving = pos - windowSize;
+                return leaving < 0 ? leaving + historySize : leaving;
             }
-            else if (peakHoldCounter_ > 0)
+
+            // Neither run may wrap, and the fresh sum has to stop at a full window.
+            int getRunLength(int numSamples, int leaving, int windowSize, int historySize) const
             {
-                peakHoldCounter_ -= numSamples;
+                return juce::jmin(numSamples, historySize - pos, historySize - leaving, windowSize - freshCount);
             }
-            else
+
+            void commit(int length, double storedSum, double leavingSum, int windowSize, int historySize)
             {
-                currentPeak_ = blockPeak;
+                sum += storedSum - leavingSum;
+                freshSum += storedSum;
+
+                pos += length;
+                if (pos == historySize)
+                    pos = 0;
+
+                freshCount += length;
+                if (freshCount == windowSize)
+                {
+                    sum = freshSum;
+                    freshSum = 0.0;
+                    freshCount = 0;
+                }
             }
+        };
+
+        void storeRun(const float* data, int numSamples, WindowState& window, double& sum, float& peak) const
+        {
+            while (numSamples > 0)
+            {
+                const int leaving = window.getLeavingPosition(windowLength_, historySize_);
+                const int length = window.getRunLength(numSamples, leaving, windowLength_, historySize_);
+
+                // The leaving run is summed before the new one is stored over it.
+                const double leavingSum = kernels_->sum(window.history + leaving, length);
+                const auto levels = kernels_->storeSquares(data, window.history + window.pos, length);
 
-            double sum = 0.0;
-            const int windowSize = rmsWindowSamples_;
-            int pos = static_cast<int>(rmsWritePos_) - windowSize;
-            if (pos < 0) pos += static_cast<int>(rmsBuffer_.size());
+                window.commit(length, levels.sumSquares, leavingSum, windowLength_, historySize_);
+                sum += levels.sumSquares;
+                peak = juce::jmax(peak, levels.peak);
 
-            for (int i = 0; i < windowSize; ++i)
+                data += length;
+                numSamples -= length;
+            }
+        }
+
+        // energyOf(offset, count) returns the energy of the next count samples.
+        template <typename EnergyFunction>
+        void accumulateBins(int numSamples, WindowState& window, double& binEnergy, int& binFill,
+                            EnergyFunction&& energyOf) const
+        {
+            for (int offset = 0; offset < numSamples;)
             {
-                sum += rmsBuffer_[(pos + i) % rmsBuffer_.size()];
+                const int count = juce::jmin(numSamples - offset, binSize_ - binFill);
+                binEnergy += energyOf(offset, count);
+                binFill += count;
+                offset += count;
+
+                if (binFill == binSize_)
+                {
+                    const float energy = static_cast<float>(binEnergy);
+                    const int leaving = window.getLeavingPosition(windowLength_, historySize_);
+                    const double leavingSum = window.history[leaving];
+
+                    window.history[window.pos] = energy;
+                    window.commit(1, energy, leavingSum, windowLength_, historySize_);
+                    binEnergy = 0.0;
+                    binFill = 0;
+                }
             }
+        }
 
-            currentRMS_ = static_cast<float>(std::sqrt(sum / (windowSize * numChannels)));
+        double getWindowEnergy(int channel) const
+        {
+            const auto& state = channels_[static_cast<size_t>(channel)];
+            return state.windowSum + state.binEnergy;
         }
 
-        float getRMSLevel() const { return currentRMS_; }
-        float getPeakLevel() const { return currentPeak_; }
+        void seedHistory(int channel, double meanSquare)
+        {
+            auto& state = channels_[static_cast<size_t>(channel)];
+            const auto entry = static_cast<float>(meanSquare * binSize_);
 
-        float getRMSdB() const
+            juce::FloatVectorOperations::fill(getChannelHistory(channel), entry, historySize_);
+            state.windowSum = static_cast<double>(entry) * windowLength_;
+            state.freshSum = 0.0;
+            state.binEnergy = meanSquare * binFill_;
+        }
+
+        // m = a * m + (1 - a) * x^2, a chunk at a time in closed form. Per channel: the channels
+        // are planar, and each chunk is one vector pass with no per-sample dependency.
+        double decayRun(const float* data, int numSamples, double meanSquare) const
         {
-            return (currentRMS_ > 0.0f) ? 20.0f * std::log10(currentRMS_) : -100.0f;
+            for (int offset = 0; offset < numSamples; offset += kExponentialChunk)
+            {
+                const int length = juce::jmin(kExponentialChunk, numSamples - offset);
+                meanSquare = expDecay_[static_cast<size_t>(length)] * meanSquare
+                           + kernels_->weightedSumSquares(data + offset, expWeights_.data() + kExponentialChunk - length, length);
+            }
+
+            return meanSquare;
         }
 
-        float getPeakdB() const
+        void updateExponentialCoefficients()
         {
-            return (currentPeak_ > 0.0f) ? 20.0f * std::log10(currentPeak_) : -100.0f;
+            const double a = std::exp(-2.0 / rmsWindowSamples_);
+
+            for (int k = 0; k <= kExponentialChunk; ++k)
+                expDecay_[static_cast<size_t>(k)] = std::pow(a, k);
+
+            for (int k = 0; k < kExponentialChunk; ++k)
+                expWeights_[static_cast<size_t>(kExponentialChunk - 1 - k)]
+                    = static_cast<float>((1.0 - a) * expDecay_[static_cast<size_t>(k)]);
         }
 
-    private:
+        void reanchor()
+        {
+            for (int ch = 0; ch < numChannels_; ++ch)
+            {
+                const float* history = getChannelHistory(ch);
+                double sum = 0.0;
+                int readPos = rmsWritePos_ - windowLength_;
+                if (readPos < 0) readPos += historySize_;
+
+                for (int i = 0; i < windowLength_; ++i)
+                {
+                    sum += history[readPos];
+                    if (++readPos == historySize_)
+                        readPos = 0;
+                }
+
+                channels_[static_cast<size_t>(ch)].windowSum = sum;
+                channels_[static_cast<size_t>(ch)].freshSum = 0.0;
+            }
+
+            freshCount_ = 0;
+        }
+
+        void finishBlock(int numChannels, int numSamples)
+        {
+            float blockPeak = 0.0f;
+            double totalMeanSquare = 0.0;
+
+            for (int ch = 0; ch < numChannels; ++ch)
+            {
+                auto& state = channels_[static_cast<size_t>(ch)];
+                updatePeakHold(state.blockPeak, state.peak, state.peakHoldCounter, numSamples);
+                blockPeak = juce::jmax(blockPeak, state.blockPeak);
+
+                // Rounding in the running sum can leave it a hair below zero after silence.
+                const double meanSquare = detector_ == Detector::Exponential
+                                              ? state.meanSquare
+                                              : juce::jmax(0.0, getWindowEnergy(ch)) / getWindowSamples();
+                state.rms = static_cast<float>(std::sqrt(meanSquare));
+                totalMeanSquare += meanSquare;
+            }
+
+            updatePeakHold(blockPeak, currentPeak_, peakHoldCounter_, numSamples);
+
+            if (numChannels > 0)
+                currentRMS_ = static_cast<float>(std::sqrt(totalMeanSquare / numChannels));
+        }
+
+        void updatePeakHold(float blockPeak, float& peak, int& holdCounter, int numSamples) const
+        {
+            if (blockPeak >= peak)
+            {
+                peak = blockPeak;
+                holdCounter = peakHoldSamples_;
+            }
+            else if (holdCounter > 0)
+            {
+                holdCounter -= numSamples;
+            }
+            else
+            {
+                peak = blockPeak;
+            }
+        }
+
+        const LevelKernels::Table* kernels_ = &LevelKernels::get();
         double sampleRate_ = 48000.0;
+        int numChannels_ = 2;
+        int binSize_ = 1;
+        int maxWindowLength_ = 1;
+        int historySize_ = 1;
+        int historyStride_ = 1;
         std::vector<float> rmsBuffer_;
-        size_t rmsWritePos_ = 0;
+        float* history_ = nullptr;
+        RealtimeMemory::LockedRegion historyLock_;
+        int rmsWritePos_ = 0;
         int rmsWindowSamples_ = 4800;
+        int windowLength_ = 4800;
+        int binFill_ = 0;
+        Detector detector_ = Detector::Window;
+        std::array<double, kExponentialChunk + 1> expDecay_{};
+        std::array<float, kExponentialChunk> expWeights_{};
         int peakHoldSamples_ = 4800;
         int peakHoldCounter_ = 0;
         float currentRMS_ = 0.0f;
         float currentPeak_ = 0.0f;
+        std::vector<ChannelState> channels_;
+        int freshCount_ = 0;
     };
 
     class GainSmoother
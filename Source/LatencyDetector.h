@@ -0,0 +1,394 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <complex>
+#include <vector>
+#include "RealtimeMemory.h"
+
+namespace GainStage
+{
+    // Estimates how far the After instance's input trails the reference it was compared
+    // against. The audio thread pushes mono, 2x-decimated frames of both signals through a
+    // lock-free FIFO; a worker thread runs GCC-PHAT (phase-transform weighted cross-
+    // correlation) on them, refines the peak to a fraction of a sample and publishes the
+    // absolute delay. Each frame carries the delay the reference was read with, so the
+    // estimate stays valid while the audio thread moves towards it.
+    class LatencyDetector : private juce::Thread
+    {
+    public:
+        static constexpr int kDecimation = 2;
+        // Decimated samples per frame, about 0.34 s at 48 kHz.
+        static constexpr int kFrameSize = 8192;
+        static constexpr int kFftOrder = 14;
+        static constexpr int kFftSize = 1 << kFftOrder;
+        // Furthest residual, in decimated samples, a frame can detect either way of the delay
+        // it was read with: about 170 ms at 48 kHz around the manual offset, which seeds it.
+        static constexpr int kMaxLag = kFrameSize / 2;
+        static constexpr int kFrameSlots = 4;
+        static constexpr float kNoEstimate = -1.0f;
+
+        LatencyDetector()
+            : juce::Thread("GainStage Latency Detector"),
+              fft_(kFftOrder)
+        {
+            for (auto& slot : slots_)
+            {
+                slot.reference.assign(kFrameSize, 0.0f);
+                slot.processed.assign(kFrameSize, 0.0f);
+                slot.referenceLock = RealtimeMemory::LockedRegion(slot.reference.data(), kFrameSize * sizeof(float));
+                slot.processedLock = RealtimeMemory::LockedRegion(slot.processed.data(), kFrameSize * sizeof(float));
+            }
+
+            referenceSpectrum_.assign(2 * kFftSize, 0.0f);
+            processedSpectrum_.assign(2 * kFftSize, 0.0f);
+            crossSpectrum_.assign(kFftSize / 2 + 1, {});
+            weightedSpectrum_.assign(kFftSize / 2 + 1, {});
+
+            startThread(juce::Thread::Priority::low);
+        }
+
+        ~LatencyDetector() override
+        {
+            stopThread(2000);
+        }
+
+        // Audio thread. reference is the Before signal as read with appliedDelay samples of
+        // delay, processed the After instance's input for the same block.
+        void push(const juce::AudioBuffer<float>& reference, const juce::AudioBuffer<float>& processed,
+                  int numSamples, float appliedDelay)
+        {
+            push(reference.getArrayOfReadPointers(), reference.getArrayOfReadPointers(), reference.getNumChannels(),
+                 numSamples, processed, numSamples, appliedDelay);
+        }
+
+        // As above with the reference split into two runs per channel, first[ch] for
+        // firstLength samples and then second[ch], as it sits in the pair's ring.
+        void push(const float* const* referenceFirst, const float* const* referenceSecond, int numReferenceChannels,
+                  int firstLength, const juce::AudioBuffer<float>& processed, int numSamples, float appliedDelay)
+        {
+            const int numChannels = juce::jmin(numReferenceChannels, processed.getNumChannels());
+            if (numChannels == 0)
+                return;
+
+            // A frame must be measured against a single delay, so a change restarts it.
+            if (frameFill_ > 0 && appliedDelay != frameDelay_)
+                frameFill_ = 0;
+
+            frameDelay_ = appliedDelay;
+            const float channelGain = 1.0f / static_cast<float>(numChannels);
+
+            for (int i = 0; i < numSamples; ++i)
+            {
+                float referenceSum = 0.0f, processedSum = 0.0f;
+
+                for (int ch = 0; ch < numChannels; ++ch)
+                {
+                    referenceSum += i < firstLength ? referenceFirst[ch][i] : referenceSecond[ch][i - firstLength];
+                    processedSum += processed.getReadPointer(ch)[i];
+                }
+
+                historyPos_ = (historyPos_ + 1) & kHistoryMask;
+                referenceHistory_[static_cast<size_t>(historyPos_)] = referenceSum * channelGain;
+                processedHistory_[static_cast<size_t>(historyPos_)] = processedSum * channelGain;
+
+                if (++pendingCount_ < kDecimation)
+                    continue;
+
+                pendingCount_ = 0;
+
+                if (frameFill_ == 0 && ! beginFrame())
+                {
+                    ++dropFill_;
+                    continue;
+                }
+
+                auto& slot = slots_[static_cast<size_t>(writeSlot_)];
+                slot.reference[static_cast<size_t>(frameFill_)] = decimate(referenceHistory_, historyPos_);
+                slot.processed[static_cast<size_t>(frameFill_)] = decimate(processedHistory_, historyPos_);
+
+                if (++frameFill_ == kFrameSize)
+                {
+                    slot.appliedDelay = frameDelay_;
+                    fifo_.finishedWrite(1);
+                    frameFill_ = 0;
+                }
+            }
+        }
+
+        // Audio thread. Throws away the frame being filled, e.g. when some of the reference
+        // just pushed turned out to be torn.
+        void restartFrame()
+        {
+            frameFill_ = 0;
+        }
+
+        // Absolute delay in samples, or kNoEstimate until a frame has produced a confident one.
+        float getEstimate() const { return estimate_.load(std::memory_order_acquire); }
+
+        // Ratio of the correlation peak to the mean correlation magnitude for the last estimate.
+        float getConfidence() const { return confidence_.load(std::memory_order_relaxed); }
+
+        // Frames the audio thread skipped because the worker hadn't caught up.
+        uint32_t getDroppedFrames() const { return droppedFrames_.load(std::memory_order_relaxed); }
+
+    private:
+        struct Frame
+        {
+            std::vector<float> reference;
+            std::vector<float> processed;
+            float appliedDelay = 0.0f;
+            RealtimeMemory::LockedRegion referenceLock;
+            RealtimeMemory::LockedRegion processedLock;
+        };
+
+        // A peak has to stand this far above the mean correlation magnitude to count.
+        static constexpr float kMinConfidence = 6.0f;
+        // Frames with less energy than this per sample are skipped as silence.
+        static constexpr float kMinFrameEnergy = 1.0e-8f;
+        // Weight the running cross-spectrum keeps from earlier frames measured at the same delay.
+        static constexpr float kSpectrumMemory = 0.6f;
+        static constexpr int kPollIntervalMs = 50;
+        static constexpr int kRefineIterations = 24;
+
+        // The 7-tap filter below reads its input from a circular history, newest at newest.
+        static constexpr int kHistorySize = 8;
+        static constexpr int kHistoryMask = kHistorySize - 1;
+
+        // Half-band low-pass ahead of the 2:1 decimation. Both signals go through it, so it
+        // can't bias the lag, but without it aliasing skews the sub-sample estimate.
+        static float decimate(const std::array<float, kHistorySize>& history, int newest)
+        {
+            const auto tap = [&](int age) { return history[static_cast<size_t>((newest - age) & kHistoryMask)]; };
+            return (16.0f * tap(3) + 9.0f * (tap(2) + tap(4)) - (tap(0) + tap(6))) / 32.0f;
+        }
+
+        bool beginFrame()
+        {
+            int start1, size1, start2, size2;
+            fifo_.prepareToWrite(1, start1, size1, start2, size2);
+
+            if (size1 == 0)
+            {
+                // Counted once per frame's worth of samples thrown away.
+                if (dropFill_ >= kFrameSize)
+                {
+                    droppedFrames_.fetch_add(1, std::memory_order_relaxed);
+                    dropFill_ = 0;
+                }
+
+                return false;
+            }
+
+            writeSlot_ = start1;
+            dropFill_ = 0;
+            return true;
+        }
+
+        void run() override
+        {
+            while (! threadShouldExit())
+            {
+                while (fifo_.getNumReady() > 0 && ! threadShouldExit())
+                {
+                    int start1, size1, start2, size2;
+                    fifo_.prepareToRead(1, start1, size1, start2, size2);
+                    analyseFrame(slots_[static_cast<size_t>(start1)]);
+                    fifo_.finishedRead(1);
+                }
+
+                wait(kPollIntervalMs);
+            }
+        }
+
+        void analyseFrame(const Frame& frame)
+        {
+            float referenceEnergy = 0.0f, processedEnergy = 0.0f;
+
+            for (int i = 0; i < kFrameSize; ++i)
+            {
+                referenceEnergy += frame.reference[static_cast<size_t>(i)] * frame.reference[static_cast<size_t>(i)];
+                processedEnergy += frame.processed[static_cast<size_t>(i)] * frame.processed[static_cast<size_t>(i)];
+            }
+
+            if (referenceEnergy < kMinFrameEnergy * kFrameSize || processedEnergy < kMinFrameEnergy * kFrameSize)
+                return;
+
+            // Zero-padded to twice the frame so the correlation is linear rather than circular.
+            std::fill(referenceSpectrum_.begin(), referenceSpectrum_.end(), 0.0f);
+            std::fill(processedSpectrum_.begin(), processedSpectrum_.end(), 0.0f);
+            std::copy(frame.reference.begin(), frame.reference.end(), referenceSpectrum_.begin());
+            std::copy(frame.processed.begin(), frame.processed.end(), processedSpectrum_.begin());
+
+            fft_.performRealOnlyForwardTransform(referenceSpectrum_.data(), true);
+            fft_.performRealOnlyForwardTransform(processedSpectrum_.data(), true);
+
+            if (frame.appliedDelay != spectrumDelay_)
+            {
+                std::fill(crossSpectrum_.begin(), crossSpectrum_.end(), std::complex<float>{});
+                spectrumDelay_ = frame.appliedDelay;
+            }
+
+            auto* reference = reinterpret_cast<const std::complex<float>*>(referenceSpectrum_.data());
+            auto* processed = reinterpret_cast<const std::complex<float>*>(processedSpectrum_.data());
+
+            for (size_t bin = 0; bin < crossSpectrum_.size(); ++bin)
+            {
+                auto& cross = crossSpectrum_[bin];
+                cross = cross * kSpectrumMemory + processed[bin] * std::conj(reference[bin]);
+
+                // PHAT weighting keeps only the phase, so the peak is equally sharp whatever
+                // the programme's spectrum or the processing's EQ.
+                const float magnitude = std::abs(cross);
+                weightedSpectrum_[bin] = magnitude > 1.0e-20f ? cross / magnitude : std::complex<float>{};
+            }
+
+            std::copy(weightedSpectrum_.begin(), weightedSpectrum_.end(),
+                      reinterpret_cast<std::complex<float>*>(referenceSpectrum_.data()));
+            fft_.performRealOnlyInverseTransform(referenceSpectrum_.data());
+            const float* r = referenceSpectrum_.data();
+
+            // Lag l sits at index l for l >= 0 and at kFftSize + l for l < 0.
+            auto at = [r](int lag) { return r[lag >= 0 ? lag : kFftSize + lag]; };
+
+            int peakLag = 0;
+            float peak = at(0), magnitudeSum = 0.0f;
+
+            for (int lag = -kMaxLag; lag <= kMaxLag; ++lag)
+            {
+                const float value = at(lag);
+                magnitudeSum += std::abs(value);
+
+                if (value > peak)
+                {
+                    peak = value;
+                    peakLag = lag;
+                }
+            }
+
+            const float mean = magnitudeSum / static_cast<float>(2 * kMaxLag + 1);
+            const float confidence = mean > 0.0f ? peak / mean : 0.0f;
+
+            if (confidence < kMinConfidence || std::abs(peakLag) >= kMaxLag)
+                return;
+
+            // A parabola through the decimated peak is biased by a good fraction of a sample,
+            // so the exact band-limited correlation is searched between the neighbours instead.
+            double low = peakLag - 1.0, high = peakLag + 1.0;
+            constexpr double goldenRatio = 0.6180339887498949;
+
+            for (int iteration = 0; iteration < kRefineIterations; ++iteration)
+            {
+                const double a = high - goldenRatio * (high - low);
+                const double b = low + goldenRatio * (high - low);
+
+                if (correlationAt(a) > correlationAt(b))
+                    high = b;
+                else
+                    low = a;
+            }
+
+            const auto residual = static_cast<float>(0.5 * (low + high) * kDecimation);
+
+            confidence_.store(confidence, std::memory_order_relaxed);
+            estimate_.store(juce::jmax(0.0f, frame.appliedDelay + residual), std::memory_order_release);
+        }
+
+        // The correlation at a fractional lag, evaluated directly from the weighted spectrum.
+        double correlationAt(double lag) const
+        {
+            const std::complex<double> rotation = std::polar(1.0, juce::MathConstants<double>::twoPi * lag / kFftSize);
+            std::complex<double> phasor{ 1.0, 0.0 };
+            double sum = 0.0;
+
+            for (size_t bin = 0; bin < weightedSpectrum_.size(); ++bin)
+            {
+                const double weight = bin == 0 || bin == weightedSpectrum_.size() - 1 ? 1.0 : 2.0;
+                sum += weight * (std::complex<double>(weightedSpectrum_[bin]) * phasor).real();
+                phasor *= rotation;
+            }
+
+            return sum;
+        }
+
+        juce::dsp::FFT fft_;
+        juce::AbstractFifo fifo_{ kFrameSlots };
+        std::array<Frame, kFrameSlots> slots_;
+
+        // Audio thread only.
+        int writeSlot_ = 0;
+        int frameFill_ = 0;
+        float frameDelay_ = 0.0f;
+        std::array<float, kHistorySize> referenceHistory_{};
+        std::array<float, kHistorySize> processedHistory_{};
+        int historyPos_ = 0;
+        int pendingCount_ = 0;
+        int dropFill_ = 0;
+
+        // Worker thread only.
+        std::vector<float> referenceSpectrum_;
+        std::vector<float> processedSpectrum_;
+        std::vector<std::complex<float>> crossSpectrum_;
+        std::vector<std::complex<float>> weightedSpectrum_;
+        float spectrumDelay_ = kNoEstimate;
+
+        std::atomic<float> estimate_{ kNoEstimate };
+        std::atomic<float> confidence_{ 0.0f };
+        std::atomic<uint32_t> droppedFrames_{ 0 };
+    };
+
+    // Third-order Lagrange fractional delay, applied to the reference to carry out the
+    // sub-sample part of an alignment. Delays between 1 and 2 samples are where the
+    // interpolator is most accurate, so callers read one sample less from the ring and let
+    // this delay by 1 + fraction.
+    class FractionalDelay
+    {
+    public:
+        void prepare(int numChannels)
+        {
+            history_.assign(static_cast<size_t>(juce::jmax(1, numChannels)), {});
+        }
+
+        void reset()
+        {
+            for (auto& channel : history_)
+                channel.fill(0.0f);
+        }
+
+        // delay must lie in [0, 3].
+        void process(juce::AudioBuffer<float>& buffer, int numSamples, float delay)
+        {
+            const float d = delay;
+            const float h0 = -(d - 1.0f) * (d - 2.0f) * (d - 3.0f) / 6.0f;
+            const float h1 = d * (d - 2.0f) * (d - 3.0f) / 2.0f;
+            const float h2 = -d * (d - 1.0f) * (d - 3.0f) / 2.0f;
+            const float h3 = d * (d - 1.0f) * (d - 2.0f) / 6.0f;
+
+            const int numChannels = juce::jmin(buffer.getNumChannels(), static_cast<int>(history_.size()));
+
+            for (int ch = 0; ch < numChannels; ++ch)
+            {
+                float* data = buffer.getWritePointer(ch);
+                auto& history = history_[static_cast<size_t>(ch)];
+
+                // history holds x[-1], x[-2], x[-3]; the block is filtered back to front so it
+                // can be done in place.
+                const std::array<float, 3> previous = history;
+                for (int k = 0; k < 3 && k < numSamples; ++k)
+                    history[static_cast<size_t>(k)] = data[numSamples - 1 - k];
+                for (int k = numSamples; k < 3; ++k)
+                    history[static_cast<size_t>(k)] = previous[static_cast<size_t>(k - numSamples)];
+
+                auto x = [data, &previous](int i) { return i >= 0 ? data[i] : previous[static_cast<size_t>(-i - 1)]; };
+
+                for (int i = numSamples - 1; i >= 0; --i)
+                    data[i] = h0 * data[i] + h1 * x(i - 1) + h2 * x(i - 2) + h3 * x(i - 3);
+            }
+        }
+
+    private:
+        std::vector<std::array<float, 3>> history_;
+    };
+}
@@ -0,0 +1,497 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include <cmath>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+ #define GAINSTAGE_X86 1
+ #include <immintrin.h>
+#else
+ #define GAINSTAGE_X86 0
+#endif
+
+// Lets one translation unit hold code for instruction sets it isn't compiled for; MSVC
+// allows the intrinsics anywhere.
+#if GAINSTAGE_X86 && (defined(__GNUC__) || defined(__clang__))
+ #define GAINSTAGE_TARGET(isa) __attribute__((target(isa)))
+#else
+ #define GAINSTAGE_TARGET(isa)
+#endif
+
+namespace GainStage
+{
+    // Block peak and sum-of-squares kernels for the analyzers and the delta path. Squares are
+    // formed in float and summed in double, as the scalar code always did, so every version
+    // agrees to within summation order. The best version for the CPU is picked on first use.
+    namespace LevelKernels
+    {
+        struct Levels
+        {
+            double sumSquares = 0.0;
+            float peak = 0.0f;
+        };
+
+        struct Table
+        {
+            const char* name;
+
+            // Writes each sample's square to squares and returns their sum and the absolute peak.
+            Levels (*storeSquares)(const float* src, float* squares, int numSamples);
+
+            // storeSquares without the store.
+            Levels (*measure)(const float* src, int numSamples);
+
+            double (*sum)(const float* src, int numSamples);
+
+            // Sum of weights[i] * src[i]^2, as a one-pole filter's response to a run of squares.
+            double (*weightedSumSquares)(const float* src, const float* weights, int numSamples);
+
+            float (*peak)(const float* src, int numSamples);
+
+            // dest[i] = (a[i] - b[i]) * gain
+            void (*difference)(const float* a, const float* b, float gain, float* dest, int numSamples);
+        };
+
+        namespace Scalar
+        {
+            inline Levels storeSquares(const float* src, float* squares, int numSamples)
+            {
+                Levels levels;
+
+                for (int i = 0; i < numSamples; ++i)
+                {
+                    const float square = src[i] * src[i];
+                    squares[i] = square;
+                    levels.sumSquares += square;
+                    levels.peak = juce::jmax(levels.peak, std::abs(src[i]));
+                }
+
+                return levels;
+            }
+
+            inline Levels measure(const float* src, int numSamples)
+            {
+                Levels levels;
+
+                for (int i = 0; i < numSamples; ++i)
+                {
+                    levels.sumSquares += src[i] * src[i];
+                    levels.peak = juce::jmax(levels.peak, std::abs(src[i]));
+                }
+
+                return levels;
+            }
+
+            inline double sum(const float* src, int numSamples)
+            {
+                double total = 0.0;
+                for (int i = 0; i < numSamples; ++i)
+                    total += src[i];
+                return total;
+            }
+
+            inline double weightedSumSquares(const float* src, const float* weights, int numSamples)
+            {
+                double total = 0.0;
+                for (int i = 0; i < numSamples; ++i)
+                    total += weights[i] * (src[i] * src[i]);
+                return total;
+            }
+
+            inline float peak(const float* src, int numSamples)
+            {
+                float result = 0.0f;
+                for (int i = 0; i < numSamples; ++i)
+                    result = juce::jmax(result, std::abs(src[i]));
+                return result;
+            }
+
+            inline void difference(const float* a, const float* b, float gain, float* dest, int numSamples)
+            {
+                for (int i = 0; i < numSamples; ++i)
+                    dest[i] = (a[i] - b[i]) * gain;
+            }
+        }
+
+       #if GAINSTAGE_X86
+        namespace SSE2
+        {
+            GAINSTAGE_TARGET("sse2") inline double reduce(__m128d v)
+            {
+                return _mm_cvtsd_f64(_mm_add_sd(v, _mm_unpackhi_pd(v, v)));
+            }
+
+            GAINSTAGE_TARGET("sse2") inline float reduceMax(__m128 v)
+            {
+                v = _mm_max_ps(v, _mm_movehl_ps(v, v));
+                v = _mm_max_ss(v, _mm_shuffle_ps(v, v, 1));
+                return _mm_cvtss_f32(v);
+            }
+
+            GAINSTAGE_TARGET("sse2") inline Levels storeSquares(const float* src, float* squares, int numSamples)
+            {
+                const __m128 absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+                __m128 peak = _mm_setzero_ps();
+                __m128d low = _mm_setzero_pd(), high = _mm_setzero_pd();
+                int i = 0;
+
+                for (; i + 4 <= numSamples; i += 4)
+                {
+                    const __m128 x = _mm_loadu_ps(src + i);
+                    const __m128 square = _mm_mul_ps(x, x);
+                    _mm_storeu_ps(squares + i, square);
+
+                    peak = _mm_max_ps(peak, _mm_and_ps(x, absMask));
+                    low = _mm_add_pd(low, _mm_cvtps_pd(square));
+                    high = _mm_add_pd(high, _mm_cvtps_pd(_mm_movehl_ps(square, square)));
+                }
+
+                auto levels = Scalar::storeSquares(src + i, squares + i, numSamples - i);
+                levels.sumSquares += reduce(_mm_add_pd(low, high));
+                levels.peak = juce::jmax(levels.peak, reduceMax(peak));
+                return levels;
+            }
+
+            GAINSTAGE_TARGET("sse2") inline Levels measure(const float* src, int numSamples)
+            {
+                const __m128 absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+                __m128 peak = _mm_setzero_ps();
+                __m128d low = _mm_setzero_pd(), high = _mm_setzero_pd();
+                int i = 0;
+
+                for (; i + 4 <= numSamples; i += 4)
+                {
+                    const __m128 x = _mm_loadu_ps(src + i);
+                    const __m128 square = _mm_mul_ps(x, x);
+
+                    peak = _mm_max_ps(peak, _mm_and_ps(x, absMask));
+                    low = _mm_add_pd(low, _mm_cvtps_pd(square));
+                    high = _mm_add_pd(high, _mm_cvtps_pd(_mm_movehl_ps(square, square)));
+                }
+
+                auto levels = Scalar::measure(src + i, numSamples - i);
+                levels.sumSquares += reduce(_mm_add_pd(low, high));
+                levels.peak = juce::jmax(levels.peak, reduceMax(peak));
+                return levels;
+            }
+
+            GAINSTAGE_TARGET("sse2") inline double sum(const float* src, int numSamples)
+            {
+                __m128d low = _mm_setzero_pd(), high = _mm_setzero_pd();
+                int i = 0;
+
+                for (; i + 4 <= numSamples; i += 4)
+                {
+                    const __m128 x = _mm_loadu_ps(src + i);
+                    low = _mm_add_pd(low, _mm_cvtps_pd(x));
+                    high = _mm_add_pd(high, _mm_cvtps_pd(_mm_movehl_ps(x, x)));
+                }
+
+                return reduce(_mm_add_pd(low, high)) + Scalar::sum(src + i, numSamples - i);
+            }
+
+            GAINSTAGE_TARGET("sse2") inline double weightedSumSquares(const float* src, const float* weights, int numSamples)
+            {
+                __m128d low = _mm_setzero_pd(), high = _mm_setzero_pd();
+                int i = 0;
+
+                for (; i + 4 <= numSamples; i += 4)
+                {
+                    const __m128 x = _mm_loadu_ps(src + i);
+                    const __m128 term = _mm_mul_ps(_mm_loadu_ps(weights + i), _mm_mul_ps(x, x));
+                    low = _mm_add_pd(low, _mm_cvtps_pd(term));
+                    high = _mm_add_pd(high, _mm_cvtps_pd(_mm_movehl_ps(term, term)));
+                }
+
+                return reduce(_mm_add_pd(low, high)) + Scalar::weightedSumSquares(src + i, weights + i, numSamples - i);
+            }
+
+            GAINSTAGE_TARGET("sse2") inline float peak(const float* src, int numSamples)
+            {
+                const __m128 absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+                __m128 result = _mm_setzero_ps();
+                int i = 0;
+
+                for (; i + 4 <= numSamples; i += 4)
+                    result = _mm_max_ps(result, _mm_and_ps(_mm_loadu_ps(src + i), absMask));
+
+                return juce::jmax(reduceMax(result), Scalar::peak(src + i, numSamples - i));
+            }
+
+            GAINSTAGE_TARGET("sse2") inline void difference(const float* a, const float* b, float gain, float* dest, int numSamples)
+            {
+                const __m128 g = _mm_set1_ps(gain);
+                int i = 0;
+
+                for (; i + 4 <= numSamples; i += 4)
+                    _mm_storeu_ps(dest + i, _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)), g));
+
+                Scalar::difference(a + i, b + i, gain, dest + i, numSamples - i);
+            }
+        }
+
+        namespace AVX2
+        {
+            GAINSTAGE_TARGET("avx2") inline double reduce(__m256d v)
+            {
+                return SSE2::reduce(_mm_add_pd(_mm256_castpd256_pd128(v), _mm256_extractf128_pd(v, 1)));
+            }
+
+            GAINSTAGE_TARGET("avx2") inline float reduceMax(__m256 v)
+            {
+                return SSE2::reduceMax(_mm_max_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1)));
+            }
+
+            GAINSTAGE_TARGET("avx2") inline Levels storeSquares(const float* src, float* squares, int numSamples)
+            {
+                const __m256 absMask = _mm256_castsi256_ps(_mm256_set1_epi32(0x7fffffff));
+                __m256 peak = _mm256_setzero_ps();
+                __m256d low = _mm256_setzero_pd(), high = _mm256_setzero_pd();
+                int i = 0;
+
+                for (; i + 8 <= numSamples; i += 8)
+                {
+                    const __m256 x = _mm256_loadu_ps(src + i);
+                    const __m256 square = _mm256_mul_ps(x, x);
+                    _mm256_storeu_ps(squares + i, square);
+
+                    peak = _mm256_max_ps(peak, _mm256_and_ps(x, absMask));
+                    low = _mm256_add_pd(low, _mm256_cvtps_pd(_mm256_castps256_ps128(square)));
+                    high = _mm256_add_pd(high, _mm256_cvtps_pd(_mm256_extractf128_ps(square, 1)));
+                }
+
+                auto levels = SSE2::storeSquares(src + i, squares + i, numSamples - i);
+                levels.sumSquares += reduce(_mm256_add_pd(low, high));
+                levels.peak = juce::jmax(levels.peak, reduceMax(peak));
+                return levels;
+            }
+
+            GAINSTAGE_TARGET("avx2") inline Levels measure(const float* src, int numSamples)
+            {
+                const __m256 absMask = _mm256_castsi256_ps(_mm256_set1_epi32(0x7fffffff));
+                __m256 peak = _mm256_setzero_ps();
+                __m256d low = _mm256_setzero_pd(), high = _mm256_setzero_pd();
+                int i = 0;
+
+                for (; i + 8 <= numSamples; i += 8)
+                {
+                    const __m256 x = _mm256_loadu_ps(src + i);
+                    const __m256 square = _mm256_mul_ps(x, x);
+
+                    peak = _mm256_max_ps(peak, _mm256_and_ps(x, absMask));
+                    low = _mm256_add_pd(low, _mm256_cvtps_pd(_mm256_castps256_ps128(square)));
+                    high = _mm256_add_pd(high, _mm256_cvtps_pd(_mm256_extractf128_ps(square, 1)));
+                }
+
+                auto levels = SSE2::measure(src + i, numSamples - i);
+                levels.sumSquares += reduce(_mm256_add_pd(low, high));
+                levels.peak = juce::jmax(levels.peak, reduceMax(peak));
+                return levels;
+            }
+
+            GAINSTAGE_TARGET("avx2") inline double sum(const float* src, int numSamples)
+            {
+                __m256d low = _mm256_setzero_pd(), high = _mm256_setzero_pd();
+                int i = 0;
+
+                for (; i + 8 <= numSamples; i += 8)
+                {
+                    const __m256 x = _mm256_loadu_ps(src + i);
+                    low = _mm256_add_pd(low, _mm256_cvtps_pd(_mm256_castps256_ps128(x)));
+                    high = _mm256_add_pd(high, _mm256_cvtps_pd(_mm256_extractf128_ps(x, 1)));
+                }
+
+                return reduce(_mm256_add_pd(low, high)) + SSE2::sum(src + i, numSamples - i);
+            }
+
+            GAINSTAGE_TARGET("avx2") inline double weightedSumSquares(const float* src, const float* weights, int numSamples)
+            {
+                __m256d low = _mm256_setzero_pd(), high = _mm256_setzero_pd();
+                int i = 0;
+
+                for (; i + 8 <= numSamples; i += 8)
+                {
+                    const __m256 x = _mm256_loadu_ps(src + i);
+                    const __m256 term = _mm256_mul_ps(_mm256_loadu_ps(weights + i), _mm256_mul_ps(x, x));
+                    low = _mm256_add_pd(low, _mm256_cvtps_pd(_mm256_castps256_ps128(term)));
+                    high = _mm256_add_pd(high, _mm256_cvtps_pd(_mm256_extractf128_ps(term, 1)));
+                }
+
+                return reduce(_mm256_add_pd(low, high)) + SSE2::weightedSumSquares(src + i, weights + i, numSamples - i);
+            }
+
+            GAINSTAGE_TARGET("avx2") inline float peak(const float* src, int numSamples)
+            {
+                const __m256 absMask = _mm256_castsi256_ps(_mm256_set1_epi32(0x7fffffff));
+                __m256 result = _mm256_setzero_ps();
+                int i = 0;
+
+                for (; i + 8 <= numSamples; i += 8)
+                    result = _mm256_max_ps(result, _mm256_and_ps(_mm256_loadu_ps(src + i), absMask));
+
+                return juce::jmax(reduceMax(result), SSE2::peak(src + i, numSamples - i));
+            }
+
+            GAINSTAGE_TARGET("avx2") inline void difference(const float* a, const float* b, float gain, float* dest, int numSamples)
+            {
+                const __m256 g = _mm256_set1_ps(gain);
+                int i = 0;
+
+                for (; i + 8 <= numSamples; i += 8)
+                    _mm256_storeu_ps(dest + i, _mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i)), g));
+
+                SSE2::difference(a + i, b + i, gain, dest + i, numSamples - i);
+            }
+        }
+
+        // GCC 12's own AVX-512 headers trip its uninitialised-use warnings once inlined here.
+       #if defined(__GNUC__) && ! defined(__clang__)
+        #pragma GCC diagnostic push
+        #pragma GCC diagnostic ignored "-Wuninitialized"
+        #pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+       #endif
+
+        // Tails are handled with masked loads, so there is no narrower fallback loop.
+        namespace AVX512
+        {
+            GAINSTAGE_TARGET("avx512f") inline __mmask16 tailMask(int remaining)
+            {
+                return static_cast<__mmask16>(remaining >= 16 ? 0xffffu : (1u << remaining) - 1u);
+            }
+
+            GAINSTAGE_TARGET("avx512f") inline __m256 upperHalf(__m512 v)
+            {
+                return _mm256_castpd_ps(_mm512_extractf64x4_pd(_mm512_castps_pd(v), 1));
+            }
+
+            GAINSTAGE_TARGET("avx512f") inline Levels storeSquares(const float* src, float* squares, int numSamples)
+            {
+                __m512 peak = _mm512_setzero_ps();
+                __m512d low = _mm512_setzero_pd(), high = _mm512_setzero_pd();
+
+                for (int i = 0; i < numSamples; i += 16)
+                {
+                    const __mmask16 mask = tailMask(numSamples - i);
+                    const __m512 x = _mm512_maskz_loadu_ps(mask, src + i);
+                    const __m512 square = _mm512_mul_ps(x, x);
+                    _mm512_mask_storeu_ps(squares + i, mask, square);
+
+                    peak = _mm512_max_ps(peak, _mm512_abs_ps(x));
+                    low = _mm512_add_pd(low, _mm512_cvtps_pd(_mm512_castps512_ps256(square)));
+                    high = _mm512_add_pd(high, _mm512_cvtps_pd(upperHalf(square)));
+                }
+
+                Levels levels;
+                levels.sumSquares = _mm512_reduce_add_pd(_mm512_add_pd(low, high));
+                levels.peak = _mm512_reduce_max_ps(peak);
+                return levels;
+            }
+
+            GAINSTAGE_TARGET("avx512f") inline Levels measure(const float* src, int numSamples)
+            {
+                __m512 peak = _mm512_setzero_ps();
+                __m512d low = _mm512_setzero_pd(), high = _mm512_setzero_pd();
+
+                for (int i = 0; i < numSamples; i += 16)
+                {
+                    const __m512 x = _mm512_maskz_loadu_ps(tailMask(numSamples - i), src + i);
+                    const __m512 square = _mm512_mul_ps(x, x);
+
+                    peak = _mm512_max_ps(peak, _mm512_abs_ps(x));
+                    low = _mm512_add_pd(low, _mm512_cvtps_pd(_mm512_castps512_ps256(square)));
+                    high = _mm512_add_pd(high, _mm512_cvtps_pd(upperHalf(square)));
+                }
+
+                Levels levels;
+                levels.sumSquares = _mm512_reduce_add_pd(_mm512_add_pd(low, high));
+                levels.peak = _mm512_reduce_max_ps(peak);
+                return levels;
+            }
+
+            GAINSTAGE_TARGET("avx512f") inline double sum(const float* src, int numSamples)
+            {
+                __m512d low = _mm512_setzero_pd(), high = _mm512_setzero_pd();
+
+                for (int i = 0; i < numSamples; i += 16)
+                {
+                    const __m512 x = _mm512_maskz_loadu_ps(tailMask(numSamples - i), src + i);
+                    low = _mm512_add_pd(low, _mm512_cvtps_pd(_mm512_castps512_ps256(x)));
+                    high = _mm512_add_pd(high, _mm512_cvtps_pd(upperHalf(x)));
+                }
+
+                return _mm512_reduce_add_pd(_mm512_add_pd(low, high));
+            }
+
+            GAINSTAGE_TARGET("avx512f") inline double weightedSumSquares(const float* src, const float* weights, int numSamples)
+            {
+                __m512d low = _mm512_setzero_pd(), high = _mm512_setzero_pd();
+
+                for (int i = 0; i < numSamples; i += 16)
+                {
+                    const __mmask16 mask = tailMask(numSamples - i);
+                    const __m512 x = _mm512_maskz_loadu_ps(mask, src + i);
+                    const __m512 term = _mm512_mul_ps(_mm512_maskz_loadu_ps(mask, weights + i), _mm512_mul_ps(x, x));
+                    low = _mm512_add_pd(low, _mm512_cvtps_pd(_mm512_castps512_ps256(term)));
+                    high = _mm512_add_pd(high, _mm512_cvtps_pd(upperHalf(term)));
+                }
+
+                return _mm512_reduce_add_pd(_mm512_add_pd(low, high));
+            }
+
+            GAINSTAGE_TARGET("avx512f") inline float peak(const float* src, int numSamples)
+            {
+                __m512 result = _mm512_setzero_ps();
+
+                for (int i = 0; i < numSamples; i += 16)
+                    result = _mm512_max_ps(result, _mm512_abs_ps(_mm512_maskz_loadu_ps(tailMask(numSamples - i), src + i)));
+
+                return _mm512_reduce_max_ps(result);
+            }
+
+            GAINSTAGE_TARGET("avx512f") inline void difference(const float* a, const float* b, float gain, float* dest, int numSamples)
+            {
+                const __m512 g = _mm512_set1_ps(gain);
+
+                for (int i = 0; i < numSamples; i += 16)
+                {
+                    const __mmask16 mask = tailMask(numSamples - i);
+                    const __m512 d = _mm512_sub_ps(_mm512_maskz_loadu_ps(mask, a + i), _mm512_maskz_loadu_ps(mask, b + i));
+                    _mm512_mask_storeu_ps(dest + i, mask, _mm512_mul_ps(d, g));
+                }
+            }
+        }
+
+       #if defined(__GNUC__) && ! defined(__clang__)
+        #pragma GCC diagnostic pop
+       #endif
+       #endif
+
+        inline Table select()
+        {
+           #if GAINSTAGE_X86
+            if (juce::SystemStats::hasAVX512F())
+                return { "AVX-512", AVX512::storeSquares, AVX512::measure, AVX512::sum, AVX512::weightedSumSquares,
+                         AVX512::peak, AVX512::difference };
+
+            if (juce::SystemStats::hasAVX2())
+                return { "AVX2", AVX2::storeSquares, AVX2::measure, AVX2::sum, AVX2::weightedSumSquares,
+                         AVX2::peak, AVX2::difference };
+
+            if (juce::SystemStats::hasSSE2())
+                return { "SSE2", SSE2::storeSquares, SSE2::measure, SSE2::sum, SSE2::weightedSumSquares,
+                         SSE2::peak, SSE2::difference };
+           #endif
+
+            return { "Scalar", Scalar::storeSquares, Scalar::measure, Scalar::sum, Scalar::weightedSumSquares,
+                     Scalar::peak, Scalar::difference };
+        }
+
+        // Chosen once per process. Analyzers fetch this when they are constructed, so the
+        // CPU query never lands on the audio thread.
+        inline const Table& get()
+        {
+            static const Table table = select();
+            return table;
+        }
+    }
+}
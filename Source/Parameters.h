@@ -4,16 +4,18 @@
 
 namespace GainStage
 {
+    // MODE, PAIR_ID, MEASUREMENT_MODE and RMS_WINDOW took new IDs when their ranges grew, so
+    // hosts don't map old automation onto the new ranges; see migrateState.
     namespace ParamIDs
     {
-        inline constexpr const char* MODE = "mode";
-        inline constexpr const char* PAIR_ID = "pairId";
+        inline constexpr const char* MODE = "modeV2";
+        inline constexpr const char* PAIR_ID = "pairIdV2";
         inline constexpr const char* INPUT_GAIN = "inputGain";
         inline constexpr const char* OUTPUT_GAIN = "outputGain";
         inline constexpr const char* BYPASS = "bypass";
 
-        inline constexpr const char* MEASUREMENT_MODE = "measurementMode";
-        inline constexpr const char* RMS_WINDOW = "rmsWindow";
+        inline constexpr const char* MEASUREMENT_MODE = "measurementModeV2";
+        inline constexpr const char* RMS_WINDOW = "rmsWindowV2";
         inline constexpr const char* ATTACK_TIME = "attackTime";
         inline constexpr const char* RELEASE_TIME = "releaseTime";
         inline constexpr const char* TOLERANCE = "tolerance";
@@ -26,6 +28,21 @@ namespace GainStage
         inline constexpr const char* LISTEN_AFTER = "listenAfter";
 
         inline constexpr const char* LATENCY_OFFSET = "latencyOffset";
+        inline constexpr const char* AUTO_ALIGN = "autoAlign";
+        inline constexpr const char* TAP_INDEX = "tapIndex";
+
+        inline constexpr const char* TRANSPORT = "transport";
+        inline constexpr const char* COMPENSATION_MODE = "compensationMode";
+        inline constexpr const char* PAIR_TIMEOUT = "pairTimeout";
+        inline constexpr const char* RING_FORMAT = "ringFormat";
+    }
+
+    namespace LegacyParamIDs
+    {
+        inline constexpr const char* MODE = "mode";
+        inline constexpr const char* PAIR_ID = "pairId";
+        inline constexpr const char* MEASUREMENT_MODE = "measurementMode";
+        inline constexpr const char* RMS_WINDOW = "rmsWindow";
     }
 
     namespace ParamDefaults
@@ -47,6 +64,13 @@ namespace GainStage
         constexpr bool DELTA_SOLO = false;
 
         constexpr int LATENCY_OFFSET = 0;
+        constexpr bool AUTO_ALIGN = false;
+        constexpr int TAP_INDEX = 1;
+
+        constexpr int TRANSPORT = 0;
+        constexpr int COMPENSATION_MODE = 0;
+        constexpr int PAIR_TIMEOUT = 48000;
+        constexpr int RING_FORMAT = 0;
     }
 
     namespace ParamRanges
@@ -63,54 +87,122 @@ namespace GainStage
         constexpr float TOLERANCE_MIN = 0.1f;
         constexpr float TOLERANCE_MAX = 3.0f;
 
+        constexpr int PAIR_ID_MIN = 1;
+        constexpr int PAIR_ID_MAX = 1024;
+
+        constexpr int PAIR_TIMEOUT_MIN = 1024;
+        constexpr int PAIR_TIMEOUT_MAX = 960000;
+
         constexpr int LATENCY_OFFSET_MIN = 0;
         constexpr int LATENCY_OFFSET_MAX = 48000;
+
+        constexpr int TAP_INDEX_MIN = 1;
+        // Also the most taps one chain can hold; see TapChain.
+        constexpr int TAP_INDEX_MAX = 1024;
     }
 
     enum class InstanceMode
     {
         Before = 0,
-        After = 1
+        After = 1,
+        // One measurement point in a chain of any number of taps; see TapChain.
+        Tap = 2,
+        // Single instance comparing against a reference on its sidechain bus.
+        Sidechain = 3
     };
 
     enum class MeasurementMode
     {
         RMS = 0,
-        Peak = 1
+        Peak = 1,
+        // RMS from a one-pole detector instead of the boxcar window; see GainAnalyzer.
+        RMSExponential = 2
+    };
+
+    enum class CompensationMode
+    {
+        Linked = 0,
+        PerChannel = 1
+    };
+
+    // Sample format of a pair's reference ring, chosen by its Before instance.
+    enum class RingFormat
+    {
+        Float32 = 0,
+        Float16 = 1,
+        ScaledInt16 = 2
     };
 
     enum class RMSWindow
     {
         Ms50 = 0,
         Ms100 = 1,
-        Ms300 = 2
+        Ms300 = 2,
+        Ms1000 = 3,
+        Ms3000 = 4
     };
 
+    // Longest RMSWindow; analyzers size their history for it.
+    constexpr double kMaxRMSWindowSeconds = 3.0;
+
+    // Samples per analyzer history bin. Windows round to whole bins, which at 32 is well under
+    // a millisecond, and a 3 s window needs only 4500 history entries per channel.
+    constexpr int kAnalyzerBinSize = 32;
+
     inline int rmsWindowToSamples(RMSWindow window, double sampleRate)
     {
         switch (window)
         {
-            case RMSWindow::Ms50:  return static_cast<int>(sampleRate * 0.050);
-            case RMSWindow::Ms100: return static_cast<int>(sampleRate * 0.100);
-            case RMSWindow::Ms300: return static_cast<int>(sampleRate * 0.300);
-            default:               return static_cast<int>(sampleRate * 0.100);
+            case RMSWindow::Ms50:   return static_cast<int>(sampleRate * 0.050);
+            case RMSWindow::Ms100:  return static_cast<int>(sampleRate * 0.100);
+            case RMSWindow::Ms300:  return static_cast<int>(sampleRate * 0.300);
+            case RMSWindow::Ms1000: return static_cast<int>(sampleRate * 1.000);
+            case RMSWindow::Ms3000: return static_cast<int>(sampleRate * kMaxRMSWindowSeconds);
+            default:                return static_cast<int>(sampleRate * 0.100);
         }
     }
 
+    // Saved with the plugin state. Version 1 predates the ParamIDs renames.
+    constexpr int kStateVersion = 2;
+    inline constexpr const char* STATE_VERSION = "stateVersion";
+
+    // Brings a saved state up to kStateVersion. The state holds plain values, and the old
+    // values are all still valid in the grown ranges, so the renamed parameters only need
+    // their IDs moved.
+    inline void migrateState(juce::XmlElement& state)
+    {
+        if (state.getIntAttribute(STATE_VERSION, 1) < 2)
+        {
+            const std::pair<const char*, const char*> renamed[] = {
+                { LegacyParamIDs::MODE, ParamIDs::MODE },
+                { LegacyParamIDs::PAIR_ID, ParamIDs::PAIR_ID },
+                { LegacyParamIDs::MEASUREMENT_MODE, ParamIDs::MEASUREMENT_MODE },
+                { LegacyParamIDs::RMS_WINDOW, ParamIDs::RMS_WINDOW }
+            };
+
+            for (auto* param : state.getChildWithTagNameIterator("PARAM"))
+                for (const auto& [from, to] : renamed)
+                    if (param->getStringAttribute("id") == from)
+                        param->setAttribute("id", to);
+        }
+
+        state.setAttribute(STATE_VERSION, kStateVersion);
+    }
+
     inline juce::AudioProcessorValueTreeState::ParameterLayout createParameterLayout()
     {
         std::vector<std::unique_ptr<juce::RangedAudioParameter>> params;
 
         params.push_back(std::make_unique<juce::AudioParameterChoice>(
-            juce::ParameterID{ ParamIDs::MODE, 1 },
+            juce::ParameterID{ ParamIDs::MODE, 2 },
             "Mode",
-            juce::StringArray{ "Before", "After" },
+            juce::StringArray{ "Before", "After", "Tap", "Sidechain" },
             ParamDefaults::MODE));
 
         params.push_back(std::make_unique<juce::AudioParameterInt>(
-            juce::ParameterID{ ParamIDs::PAIR_ID, 1 },
+            juce::ParameterID{ ParamIDs::PAIR_ID, 2 },
             "Pair ID",
-            1, 16,
+            ParamRanges::PAIR_ID_MIN, ParamRanges::PAIR_ID_MAX,
             ParamDefaults::PAIR_ID));
 
         params.push_back(std::make_unique<juce::AudioParameterFloat>(
@@ -133,15 +225,15 @@ namespace GainStage
             ParamDefaults::BYPASS));
 
         params.push_back(std::make_unique<juce::AudioParameterChoice>(
-            juce::ParameterID{ ParamIDs::MEASUREMENT_MODE, 1 },
+            juce::ParameterID{ ParamIDs::MEASUREMENT_MODE, 2 },
             "Measurement Mode",
-            juce::StringArray{ "RMS", "Peak" },
+            juce::StringArray{ "RMS", "Peak", "RMS Exp" },
             ParamDefaults::MEASUREMENT_MODE));
 
         params.push_back(std::make_unique<juce::AudioParameterChoice>(
-            juce::ParameterID{ ParamIDs::RMS_WINDOW, 1 },
+            juce::ParameterID{ ParamIDs::RMS_WINDOW, 2 },
             "RMS Window",
-            juce::StringArray{ "50ms", "100ms", "300ms" },
+            juce::StringArray{ "50ms", "100ms", "300ms", "1s", "3s" },
             ParamDefaults::RMS_WINDOW));
 
         params.push_back(std::make_unique<juce::AudioParameterFloat>(
@@ -199,6 +291,43 @@ namespace GainStage
             ParamRanges::LATENCY_OFFSET_MAX,
             ParamDefaults::LATENCY_OFFSET));
 
+        params.push_back(std::make_unique<juce::AudioParameterBool>(
+            juce::ParameterID{ ParamIDs::AUTO_ALIGN, 1 },
+            "Auto Align",
+            ParamDefaults::AUTO_ALIGN));
+
+        params.push_back(std::make_unique<juce::AudioParameterInt>(
+            juce::ParameterID{ ParamIDs::TAP_INDEX, 2 },
+            "Tap Position",
+            ParamRanges::TAP_INDEX_MIN, ParamRanges::TAP_INDEX_MAX,
+            ParamDefaults::TAP_INDEX));
+
+        params.push_back(std::make_unique<juce::AudioParameterChoice>(
+            juce::ParameterID{ ParamIDs::TRANSPORT, 1 },
+            "Transport",
+            juce::StringArray{ "In-Process", "Shared Memory" },
+            ParamDefaults::TRANSPORT));
+
+        params.push_back(std::make_unique<juce::AudioParameterChoice>(
+            juce::ParameterID{ ParamIDs::COMPENSATION_MODE, 1 },
+            "Compensation",
+            juce::StringArray{ "Linked", "Per Channel" },
+            ParamDefaults::COMPENSATION_MODE));
+
+        params.push_back(std::make_unique<juce::AudioParameterInt>(
+            juce::ParameterID{ ParamIDs::PAIR_TIMEOUT, 1 },
+            "Unpaired Timeout",
+            ParamRanges::PAIR_TIMEOUT_MIN,
+            ParamRanges::PAIR_TIMEOUT_MAX,
+            ParamDefaults::PAIR_TIMEOUT,
+            juce::AudioParameterIntAttributes().withLabel("samples")));
+
+        params.push_back(std::make_unique<juce::AudioParameterChoice>(
+            juce::ParameterID{ ParamIDs::RING_FORMAT, 1 },
+            "Reference Format",
+            juce::StringArray{ "Float 32", "Float 16", "Int 16 (Scaled)" },
+            ParamDefaults::RING_FORMAT));
+
         return { params.begin(), params.end() };
     }
 }
@@ -6,23 +6,19 @@ UltimateGainStageAudioProcessorEditor::UltimateGainStageAudioProcessorEditor(Ult
 {
     setLookAndFeel(&customLookAndFeel_);
 
-    // Mode toggle
-    modeToggle_.setButtonText("AFTER");
-    modeToggle_.onClick = [this]()
-    {
-        auto* param = audioProcessor.getAPVTS().getParameter(GainStage::ParamIDs::MODE);
-        param->setValueNotifyingHost(modeToggle_.getToggleState() ? 1.0f : 0.0f);
-        updateUIForMode();
-    };
-    addAndMakeVisible(modeToggle_);
+    // Mode
+    modeCombo_.addItemList({ "Before", "After", "Tap", "Sidechain" }, 1);
+    addAndMakeVisible(modeCombo_);
+    modeAttachment_ = std::make_unique<juce::AudioProcessorValueTreeState::ComboBoxAttachment>(
+        audioProcessor.getAPVTS(), GainStage::ParamIDs::MODE, modeCombo_);
 
     // Pair ID
-    for (int i = 1; i <= 16; ++i)
-        pairIdCombo_.addItem("Pair " + juce::String(i), i);
-    pairIdCombo_.setSelectedId(1);
-    addAndMakeVisible(pairIdCombo_);
-    pairIdAttachment_ = std::make_unique<juce::AudioProcessorValueTreeState::ComboBoxAttachment>(
-        audioProcessor.getAPVTS(), GainStage::ParamIDs::PAIR_ID, pairIdCombo_);
+    pairIdSlider_.setSliderStyle(juce::Slider::IncDecButtons);
+    pairIdSlider_.setTextBoxStyle(juce::Slider::TextBoxLeft, false, 50, 20);
+    pairIdSlider_.setIncDecButtonsMode(juce::Slider::incDecButtonsDraggable_Vertical);
+    addAndMakeVisible(pairIdSlider_);
+    pairIdAttachment_ = std::make_unique<juce::AudioProcessorValueTreeState::SliderAttachment>(
+        audioProcessor.getAPVTS(), GainStage::ParamIDs::PAIR_ID, pairIdSlider_);
 
     // Status indicators
     addAndMakeVisible(pairStatus_);
@@ -45,6 +41,7 @@ UltimateGainStageAudioProcessorEditor::UltimateGainStageAudioProcessorEditor(Ult
     // Measurement mode
     measurementModeCombo_.addItem("RMS", 1);
     measurementModeCombo_.addItem("Peak", 2);
+    measurementModeCombo_.addItem("RMS Exp", 3);
     addAndMakeVisible(measurementModeCombo_);
     measurementModeAttachment_ = std::make_unique<juce::AudioProcessorValueTreeState::ComboBoxAttachment>(
         audioProcessor.getAPVTS(), GainStage::ParamIDs::MEASUREMENT_MODE, measurementModeCombo_);
@@ -53,10 +50,19 @@ UltimateGainStageAudioProcessorEditor::UltimateGainStageAudioProcessorEditor(Ult
     rmsWindowCombo_.addItem("50 ms", 1);
     rmsWindowCombo_.addItem("100 ms", 2);
     rmsWindowCombo_.addItem("300 ms", 3);
+    rmsWindowCombo_.addItem("1 s", 4);
+    rmsWindowCombo_.addItem("3 s", 5);
     addAndMakeVisible(rmsWindowCombo_);
     rmsWindowAttachment_ = std::make_unique<juce::AudioProcessorValueTreeState::ComboBoxAttachment>(
         audioProcessor.getAPVTS(), GainStage::ParamIDs::RMS_WINDOW, rmsWindowCombo_);
 
+    // Compensation mode
+    compensationModeCombo_.addItem("Linked", 1);
+    compensationModeCombo_.addItem("Per Channel", 2);
+    addAndMakeVisible(compensationModeCombo_);
+    compensationModeAttachment_ = std::make_unique<juce::AudioProcessorValueTreeState::ComboBoxAttachment>(
+        audioProcessor.getAPVTS(), GainStage::ParamIDs::COMPENSATION_MODE, compensationModeCombo_);
+
     // Attack slider
     attackSlider_.setSliderStyle(juce::Slider::RotaryHorizontalVerticalDrag);
     attackSlider_.setTextBoxStyle(juce::Slider::TextBoxBelow, false, 60, 18);
@@ -123,13 +129,34 @@ UltimateGainStageAudioProcessorEditor::UltimateGainStageAudioProcessorEditor(Ult
     latencyLabel_.setColour(juce::Label::textColourId, GainStage::Colours::textSecondary);
     addAndMakeVisible(latencyLabel_);
 
-    // Initialize mode from parameter
-    auto* modeParam = audioProcessor.getAPVTS().getRawParameterValue(GainStage::ParamIDs::MODE);
-    modeToggle_.setToggleState(modeParam->load() > 0.5f, juce::dontSendNotification);
+    addAndMakeVisible(autoAlignToggle_);
+    autoAlignAttachment_ = std::make_unique<juce::AudioProcessorValueTreeState::ButtonAttachment>(
+        audioProcessor.getAPVTS(), GainStage::ParamIDs::AUTO_ALIGN, autoAlignToggle_);
+
+    // Tap position
+    tapIndexSlider_.setSliderStyle(juce::Slider::IncDecButtons);
+    tapIndexSlider_.setTextBoxStyle(juce::Slider::TextBoxLeft, false, 50, 20);
+    tapIndexSlider_.setIncDecButtonsMode(juce::Slider::incDecButtonsDraggable_Vertical);
+    addAndMakeVisible(tapIndexSlider_);
+    tapIndexAttachment_ = std::make_unique<juce::AudioProcessorValueTreeState::SliderAttachment>(
+        audioProcessor.getAPVTS(), GainStage::ParamIDs::TAP_INDEX, tapIndexSlider_);
+    tapIndexLabel_.setColour(juce::Label::textColourId, GainStage::Colours::textSecondary);
+    addAndMakeVisible(tapIndexLabel_);
+    addAndMakeVisible(tapChainView_);
+
+    // Diagnostics
+    diagnosticsLabel_.setFont(juce::Font(11.0f));
+    diagnosticsLabel_.setColour(juce::Label::textColourId, GainStage::Colours::textSecondary);
+    addAndMakeVisible(diagnosticsLabel_);
+    copyDiagnosticsButton_.onClick = [this] { juce::SystemClipboard::copyTextToClipboard(audioProcessor.dumpDiagnostics()); };
+    addAndMakeVisible(copyDiagnosticsButton_);
+
+    // Set last, once every component the layout touches exists.
+    modeCombo_.onChange = [this] { updateUIForMode(); };
 
     updateUIForMode();
     startTimerHz(30);
-    setSize(650, 500);
+    setSize(650, 530);
 }
 
 UltimateGainStageAudioProcessorEditor::~UltimateGainStageAudioProcessorEditor()
@@ -138,10 +165,18 @@ UltimateGainStageAudioProcessorEditor::~UltimateGainStageAudioProcessorEditor()
     setLookAndFeel(nullptr);
 }
 
+GainStage::InstanceMode UltimateGainStageAudioProcessorEditor::getSelectedMode() const
+{
+    return static_cast<GainStage::InstanceMode>(juce::jmax(0, modeCombo_.getSelectedItemIndex()));
+}
+
 void UltimateGainStageAudioProcessorEditor::updateUIForMode()
 {
-    bool isAfterMode = modeToggle_.getToggleState();
-    modeToggle_.setButtonText(isAfterMode ? "AFTER" : "BEFORE");
+    const auto mode = getSelectedMode();
+    // Sidechain mode compares and compensates exactly like After, minus the pair alignment.
+    const bool isPairedAfter = mode == GainStage::InstanceMode::After;
+    const bool isAfterMode = isPairedAfter || mode == GainStage::InstanceMode::Sidechain;
+    const bool isTapMode = mode == GainStage::InstanceMode::Tap;
 
     // Show/hide controls based on mode
     afterMeter_.setVisible(isAfterMode);
@@ -153,8 +188,9 @@ void UltimateGainStageAudioProcessorEditor::updateUIForMode()
     warningStatus_.setVisible(isAfterMode);
     clippingStatus_.setVisible(isAfterMode);
 
-    measurementModeCombo_.setVisible(isAfterMode);
-    rmsWindowCombo_.setVisible(isAfterMode);
+    measurementModeCombo_.setVisible(isAfterMode || isTapMode);
+    rmsWindowCombo_.setVisible(isAfterMode || isTapMode);
+    compensationModeCombo_.setVisible(isAfterMode);
 
     attackSlider_.setVisible(isAfterMode);
     releaseSlider_.setVisible(isAfterMode);
@@ -169,11 +205,23 @@ void UltimateGainStageAudioProcessorEditor::updateUIForMode()
     deltaGainLabel_.setVisible(isAfterMode);
 
     listenBeforeToggle_.setVisible(isAfterMode);
-    latencyOffsetSlider_.setVisible(isAfterMode);
-    latencyLabel_.setVisible(isAfterMode);
+    latencyOffsetSlider_.setVisible(isPairedAfter);
+    latencyLabel_.setVisible(isPairedAfter);
+    autoAlignToggle_.setVisible(isPairedAfter);
+    diagnosticsLabel_.setVisible(isPairedAfter);
+    copyDiagnosticsButton_.setVisible(isPairedAfter);
+
+    // Sidechain mode takes its reference from the host, not from a pair.
+    pairIdSlider_.setVisible(mode != GainStage::InstanceMode::Sidechain);
+    beforeMeter_.setVisible(! isTapMode);
+    tapIndexSlider_.setVisible(isTapMode);
+    tapIndexLabel_.setVisible(isTapMode);
+    tapChainView_.setVisible(isTapMode);
 
     if (isAfterMode)
-        setSize(650, 500);
+        setSize(650, 530);
+    else if (isTapMode)
+        setSize(650, 200 + TapChainView::kVisibleRows * TapChainView::kRowHeight);
     else
         setSize(320, 280);
 
@@ -190,11 +238,28 @@ void UltimateGainStageAudioProcessorEditor::timerCallback()
         pairStatus_.setStatus(true, "SENDING", GainStage::Colours::success);
         beforeMeter_.setLevel(audioProcessor.getBeforeLeveldB());
     }
-    else
+    else if (mode == GainStage::InstanceMode::Tap)
     {
-        pairStatus_.setStatus(isPaired, isPaired ? "PAIRED" : "NOT PAIRED",
+        pairStatus_.setStatus(isPaired, isPaired ? "IN CHAIN" : "CHAIN FULL",
                               isPaired ? GainStage::Colours::success : GainStage::Colours::meterRed);
 
+        const bool useRMS = static_cast<GainStage::MeasurementMode>(measurementModeCombo_.getSelectedItemIndex())
+                         != GainStage::MeasurementMode::Peak;
+        tapChainView_.setTaps(audioProcessor.getTapChain(), audioProcessor.getTapSlot(), useRMS);
+    }
+    else
+    {
+        if (mode == GainStage::InstanceMode::Sidechain)
+            pairStatus_.setStatus(isPaired, isPaired ? "SIDECHAIN" : "NO SIDECHAIN",
+                                  isPaired ? GainStage::Colours::success : GainStage::Colours::meterRed);
+        else if (audioProcessor.isPairFull())
+            pairStatus_.setStatus(false, "PAIR FULL", GainStage::Colours::meterRed);
+        else if (isPaired && audioProcessor.isRingTooShort())
+            pairStatus_.setStatus(true, "RING TOO SHORT", GainStage::Colours::warning);
+        else
+            pairStatus_.setStatus(isPaired, isPaired ? "PAIRED" : "NOT PAIRED",
+                                  isPaired ? GainStage::Colours::success : GainStage::Colours::meterRed);
+
         beforeMeter_.setLevel(audioProcessor.getBeforeLeveldB());
         afterMeter_.setLevel(audioProcessor.getAfterLeveldB());
         gainMeter_.setGainReduction(audioProcessor.getGainReductionDB());
@@ -204,6 +269,23 @@ void UltimateGainStageAudioProcessorEditor::timerCallback()
         compensatingStatus_.setStatus(audioProcessor.isCompensating(), "COMPENSATING", GainStage::Colours::accent);
         warningStatus_.setStatus(audioProcessor.isWarning(), "HIGH GAIN", GainStage::Colours::warning);
         clippingStatus_.setStatus(audioProcessor.isClipping(), "CLIPPING", GainStage::Colours::meterRed);
+
+        // With auto-align on the slider only seeds the search; show what is actually applied.
+        latencyLabel_.setText(audioProcessor.isAutoAligned()
+                                  ? "Latency Offset (auto: " + juce::String(audioProcessor.getAppliedLatency(), 2) + " samples)"
+                                  : juce::String("Latency Offset (samples)"),
+                              juce::dontSendNotification);
+
+        // Reads before write mean the host ran this instance first in the cycle; under- and
+        // overruns mean the reference repeated or skipped samples.
+        const auto diagnostics = audioProcessor.getDiagnostics().pair;
+        diagnosticsLabel_.setText(diagnostics.valid
+                                      ? "Behind " + juce::String(diagnostics.samplesBehind) + " smp  |  blocks lag "
+                                            + juce::String(diagnostics.blockLag) + "  |  read before write "
+                                            + juce::String(diagnostics.readsBeforeWrite) + "  |  under "
+                                            + juce::String(diagnostics.underruns) + " / over " + juce::String(diagnostics.overruns)
+                                      : juce::String("No reader slot"),
+                                  juce::dontSendNotification);
     }
 }
 
@@ -236,11 +318,14 @@ void UltimateGainStageAudioProcessorEditor::paint(juce::Graphics& g)
     // Subtitle
     g.setColour(GainStage::Colours::textSecondary);
     g.setFont(juce::Font(11.0f));
-    g.drawText(mode == GainStage::InstanceMode::Before ? "Reference Capture" : "Gain Compensation + Delta Monitor",
-               20, 38, 300, 20, juce::Justification::centredLeft);
-
-    // Section backgrounds for After mode
-    if (mode == GainStage::InstanceMode::After)
+    juce::String subtitle = (mode == GainStage::InstanceMode::Before)    ? "Reference Capture"
+                          : (mode == GainStage::InstanceMode::Tap)       ? "Chain Tap"
+                          : (mode == GainStage::InstanceMode::Sidechain) ? "Gain Compensation + Delta Monitor (Sidechain)"
+                                                                         : "Gain Compensation + Delta Monitor";
+    g.drawText(subtitle, 20, 38, 300, 20, juce::Justification::centredLeft);
+
+    // Section backgrounds for After and Sidechain modes
+    if (mode == GainStage::InstanceMode::After || mode == GainStage::InstanceMode::Sidechain)
     {
         auto contentBounds = getLocalBounds().reduced(10).withTrimmedTop(60);
 
@@ -277,9 +362,9 @@ void UltimateGainStageAudioProcessorEditor::resized()
     auto headerLeft = headerBounds.removeFromLeft(300);
     headerLeft.removeFromLeft(180); // Skip title area
 
-    modeToggle_.setBounds(headerLeft.removeFromLeft(80).reduced(2));
+    modeCombo_.setBounds(headerLeft.removeFromLeft(80).reduced(2));
     headerLeft.removeFromLeft(10);
-    pairIdCombo_.setBounds(headerLeft.removeFromLeft(90).reduced(2));
+    pairIdSlider_.setBounds(headerLeft.removeFromLeft(90).reduced(2));
 
     auto headerRight = headerBounds.removeFromRight(200);
     bypassToggle_.setBounds(headerRight.removeFromRight(80).reduced(2));
@@ -288,9 +373,24 @@ void UltimateGainStageAudioProcessorEditor::resized()
 
     bounds.reduce(10, 0);
 
-    bool isAfterMode = modeToggle_.getToggleState();
+    const auto mode = getSelectedMode();
 
-    if (!isAfterMode)
+    if (mode == GainStage::InstanceMode::Tap)
+    {
+        bounds.removeFromTop(10);
+
+        auto topControls = bounds.removeFromTop(30).reduced(10, 0);
+        measurementModeCombo_.setBounds(topControls.removeFromLeft(100));
+        topControls.removeFromLeft(10);
+        rmsWindowCombo_.setBounds(topControls.removeFromLeft(100));
+        topControls.removeFromLeft(20);
+        tapIndexLabel_.setBounds(topControls.removeFromLeft(60));
+        tapIndexSlider_.setBounds(topControls.removeFromLeft(90));
+
+        bounds.removeFromTop(10);
+        tapChainView_.setBounds(bounds.removeFromTop((TapChainView::kVisibleRows + 2) * TapChainView::kRowHeight + 16));
+    }
+    else if (mode == GainStage::InstanceMode::Before)
     {
         // Before mode - simple layout
         auto meterArea = bounds.reduced(40, 20);
@@ -338,6 +438,8 @@ void UltimateGainStageAudioProcessorEditor::resized()
         measurementModeCombo_.setBounds(topControls.removeFromLeft(100));
         topControls.removeFromLeft(10);
         rmsWindowCombo_.setBounds(topControls.removeFromLeft(100));
+        topControls.removeFromLeft(10);
+        compensationModeCombo_.setBounds(topControls.removeFromLeft(120));
 
         controlsSection.removeFromTop(10);
 
@@ -369,6 +471,8 @@ void UltimateGainStageAudioProcessorEditor::resized()
         deltaSoloToggle_.setBounds(deltaTopRow.removeFromLeft(70));
         deltaTopRow.removeFromLeft(20);
         listenBeforeToggle_.setBounds(deltaTopRow.removeFromLeft(100));
+        deltaTopRow.removeFromLeft(10);
+        autoAlignToggle_.setBounds(deltaTopRow.removeFromLeft(110));
 
         deltaSection.removeFromTop(5);
 
@@ -381,5 +485,9 @@ void UltimateGainStageAudioProcessorEditor::resized()
         auto latencyArea = deltaBottomRow;
         latencyLabel_.setBounds(latencyArea.removeFromTop(20));
         latencyOffsetSlider_.setBounds(latencyArea.removeFromTop(25));
+
+        auto diagnosticsRow = deltaSection.removeFromTop(20);
+        copyDiagnosticsButton_.setBounds(diagnosticsRow.removeFromRight(130));
+        diagnosticsLabel_.setBounds(diagnosticsRow);
     }
 }
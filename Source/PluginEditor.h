@@ -168,6 +168,158 @@ private:
     juce::Colour colour_ = GainStage::Colours::success;
 };
 
+// Lists every tap on a chain in order, with its level and the gain its stage added since
+// the tap before it.
+class TapChainView : public juce::Component
+{
+public:
+    void setTaps(std::vector<GainStage::TapInfo> taps, int ownSlot, bool useRMS)
+    {
+        // A tap whose block count stops moving has been deactivated or bypassed by the host.
+        for (const auto& tap : taps)
+        {
+            if (static_cast<size_t>(tap.slot) >= seen_.size())
+                seen_.resize(static_cast<size_t>(tap.slot) + 1);
+
+            auto& seen = seen_[static_cast<size_t>(tap.slot)];
+
+            if (tap.blocks != seen.blocks)
+            {
+                seen.blocks = tap.blocks;
+                seen.idleTicks = 0;
+            }
+            else if (seen.idleTicks < kIdleTicks)
+            {
+                ++seen.idleTicks;
+            }
+        }
+
+        taps_ = std::move(taps);
+        ownSlot_ = ownSlot;
+        useRMS_ = useRMS;
+        repaint();
+    }
+
+    void paint(juce::Graphics& g) override
+    {
+        auto bounds = getLocalBounds().toFloat();
+
+        g.setColour(GainStage::Colours::panelBackground.withAlpha(0.3f));
+        g.fillRoundedRectangle(bounds, 8.0f);
+
+        auto area = getLocalBounds().reduced(12, 8);
+        auto header = area.removeFromTop(kRowHeight);
+
+        g.setColour(GainStage::Colours::textSecondary);
+        g.setFont(juce::Font(11.0f, juce::Font::bold));
+        g.drawText("POSITION", header.removeFromLeft(90), juce::Justification::centredLeft);
+        g.drawText(useRMS_ ? "RMS" : "PEAK", header.removeFromLeft(110), juce::Justification::centredRight);
+        g.drawText("STAGE GAIN", header.removeFromLeft(130), juce::Justification::centredRight);
+
+        if (taps_.empty())
+        {
+            g.setFont(juce::Font(12.0f));
+            g.drawText("No taps on this chain", area, juce::Justification::centred);
+            return;
+        }
+
+        TapSummary first, last;
+        int activeTaps = 0;
+
+        // Past kVisibleRows the last row just counts the taps left out; they still feed the overall gain.
+        const int numTaps = static_cast<int>(taps_.size());
+        const int drawnTaps = numTaps > kVisibleRows ? kVisibleRows - 1 : numTaps;
+
+        for (int index = 0; index < numTaps; ++index)
+        {
+            const auto& tap = taps_[static_cast<size_t>(index)];
+            const bool idle = seen_[static_cast<size_t>(tap.slot)].idleTicks >= kIdleTicks;
+            const TapSummary current{ tap.ordinal, useRMS_ ? tap.rmsdB : tap.peakdB };
+
+            if (index < drawnTaps)
+            {
+                auto row = area.removeFromTop(kRowHeight);
+
+                if (tap.slot == ownSlot_)
+                {
+                    g.setColour(GainStage::Colours::accent.withAlpha(0.2f));
+                    g.fillRoundedRectangle(row.toFloat(), 4.0f);
+                }
+
+                g.setColour(idle ? GainStage::Colours::textSecondary : GainStage::Colours::textPrimary);
+                g.setFont(juce::Font(12.0f, tap.slot == ownSlot_ ? juce::Font::bold : juce::Font::plain));
+                g.drawText("Tap " + juce::String(tap.ordinal), row.removeFromLeft(90), juce::Justification::centredLeft);
+                g.drawText(idle ? juce::String("idle") : juce::String(current.leveldB, 1) + " dB", row.removeFromLeft(110),
+                           juce::Justification::centredRight);
+
+                // Idle taps are skipped, so each gain spans back to the last tap still running.
+                if (! idle && activeTaps > 0)
+                {
+                    const float gain = current.leveldB - last.leveldB;
+                    g.setColour(std::abs(gain) > 10.0f ? GainStage::Colours::warning : GainStage::Colours::textPrimary);
+                    g.drawText(formatGain(gain), row.removeFromLeft(130), juce::Justification::centredRight);
+                }
+            }
+
+            if (idle)
+                continue;
+
+            if (activeTaps++ == 0)
+                first = current;
+
+            last = current;
+        }
+
+        if (drawnTaps < numTaps)
+        {
+            g.setColour(GainStage::Colours::textSecondary);
+            g.setFont(juce::Font(12.0f));
+            g.drawText("+" + juce::String(numTaps - drawnTaps) + " more", area.removeFromTop(kRowHeight),
+                       juce::Justification::centredLeft);
+        }
+
+        if (activeTaps > 1)
+        {
+            auto row = area.removeFromTop(kRowHeight);
+            g.setColour(GainStage::Colours::accentBright);
+            g.setFont(juce::Font(12.0f, juce::Font::bold));
+            g.drawText("Tap " + juce::String(first.ordinal) + " to " + juce::String(last.ordinal), row.removeFromLeft(200),
+                       juce::Justification::centredLeft);
+            g.drawText(formatGain(last.leveldB - first.leveldB), row.removeFromLeft(130), juce::Justification::centredRight);
+        }
+    }
+
+    static constexpr int kRowHeight = 20;
+    static constexpr int kVisibleRows = 16;
+
+private:
+    struct TapSummary
+    {
+        int ordinal = 0;
+        float leveldB = -100.0f;
+    };
+
+    struct SeenTap
+    {
+        uint64_t blocks = 0;
+        int idleTicks = 0;
+    };
+
+    // Half a second at the editor's 30 Hz refresh.
+    static constexpr int kIdleTicks = 15;
+
+    static juce::String formatGain(float gain)
+    {
+        return (gain >= 0.0f ? "+" : "") + juce::String(gain, 1) + " dB";
+    }
+
+    std::vector<GainStage::TapInfo> taps_;
+    // Indexed by slot; grows with the chain.
+    std::vector<SeenTap> seen_;
+    int ownSlot_ = -1;
+    bool useRMS_ = true;
+};
+
 class UltimateGainStageAudioProcessorEditor : public juce::AudioProcessorEditor,
                                                public juce::Timer
 {
@@ -181,13 +333,14 @@ public:
 
 private:
     void updateUIForMode();
+    GainStage::InstanceMode getSelectedMode() const;
 
     UltimateGainStageAudioProcessor& audioProcessor;
     GainStage::CustomLookAndFeel customLookAndFeel_;
 
     // Header
-    juce::ToggleButton modeToggle_{ "AFTER" };
-    juce::ComboBox pairIdCombo_;
+    juce::ComboBox modeCombo_;
+    juce::Slider pairIdSlider_;
     StatusIndicator pairStatus_;
     juce::ToggleButton bypassToggle_{ "BYPASS" };
 
@@ -206,6 +359,7 @@ private:
     // Controls
     juce::ComboBox measurementModeCombo_;
     juce::ComboBox rmsWindowCombo_;
+    juce::ComboBox compensationModeCombo_;
     juce::Slider attackSlider_;
     juce::Slider releaseSlider_;
     juce::Slider toleranceSlider_;
@@ -225,11 +379,23 @@ private:
     // Latency
     juce::Slider latencyOffsetSlider_;
     juce::Label latencyLabel_{ {}, "Latency Offset (samples)" };
+    juce::ToggleButton autoAlignToggle_{ "AUTO ALIGN" };
+
+    // Tap mode
+    juce::Slider tapIndexSlider_;
+    juce::Label tapIndexLabel_{ {}, "Position" };
+    TapChainView tapChainView_;
+
+    // Diagnostics
+    juce::Label diagnosticsLabel_;
+    juce::TextButton copyDiagnosticsButton_{ "COPY DIAGNOSTICS" };
 
     // Attachments
-    std::unique_ptr<juce::AudioProcessorValueTreeState::ComboBoxAttachment> pairIdAttachment_;
+    std::unique_ptr<juce::AudioProcessorValueTreeState::ComboBoxAttachment> modeAttachment_;
+    std::unique_ptr<juce::AudioProcessorValueTreeState::SliderAttachment> pairIdAttachment_;
     std::unique_ptr<juce::AudioProcessorValueTreeState::ComboBoxAttachment> measurementModeAttachment_;
     std::unique_ptr<juce::AudioProcessorValueTreeState::ComboBoxAttachment> rmsWindowAttachment_;
+    std::unique_ptr<juce::AudioProcessorValueTreeState::ComboBoxAttachment> compensationModeAttachment_;
     std::unique_ptr<juce::AudioProcessorValueTreeState::SliderAttachment> attackAttachment_;
     std::unique_ptr<juce::AudioProcessorValueTreeState::SliderAttachment> releaseAttachment_;
     std::unique_ptr<juce::AudioProcessorValueTreeState::SliderAttachment> toleranceAttachment_;
@@ -239,6 +405,8 @@ private:
     std::unique_ptr<juce::AudioProcessorValueTreeState::ButtonAttachment> listenBeforeAttachment_;
     std::unique_ptr<juce::AudioProcessorValueTreeState::ButtonAttachment> bypassAttachment_;
     std::unique_ptr<juce::AudioProcessorValueTreeState::SliderAttachment> latencyOffsetAttachment_;
+    std::unique_ptr<juce::AudioProcessorValueTreeState::ButtonAttachment> autoAlignAttachment_;
+    std::unique_ptr<juce::AudioProcessorValueTreeState::SliderAttachment> tapIndexAttachment_;
 
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(UltimateGainStageAudioProcessorEditor)
 };
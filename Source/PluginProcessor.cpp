@@ -7,6 +7,7 @@ UltimateGainStageAudioProcessor::UltimateGainStageAudioProcessor()
 #if ! JucePlugin_IsMidiEffect
 #if ! JucePlugin_IsSynth
         .withInput("Input", juce::AudioChannelSet::stereo(), true)
+        .withInput("Sidechain", juce::AudioChannelSet::stereo(), false)
 #endif
         .withOutput("Output", juce::AudioChannelSet::stereo(), true)
 #endif
@@ -32,14 +33,37 @@ UltimateGainStageAudioProcessor::UltimateGainStageAudioProcessor()
     listenBeforeParam_ = dynamic_cast<juce::AudioParameterBool*>(apvts_.getParameter(GainStage::ParamIDs::LISTEN_BEFORE));
     listenAfterParam_ = dynamic_cast<juce::AudioParameterBool*>(apvts_.getParameter(GainStage::ParamIDs::LISTEN_AFTER));
     latencyOffsetParam_ = dynamic_cast<juce::AudioParameterInt*>(apvts_.getParameter(GainStage::ParamIDs::LATENCY_OFFSET));
+    transportParam_ = dynamic_cast<juce::AudioParameterChoice*>(apvts_.getParameter(GainStage::ParamIDs::TRANSPORT));
+    pairTimeoutParam_ = dynamic_cast<juce::AudioParameterInt*>(apvts_.getParameter(GainStage::ParamIDs::PAIR_TIMEOUT));
+    compensationModeParam_ = dynamic_cast<juce::AudioParameterChoice*>(apvts_.getParameter(GainStage::ParamIDs::COMPENSATION_MODE));
+    ringFormatParam_ = dynamic_cast<juce::AudioParameterChoice*>(apvts_.getParameter(GainStage::ParamIDs::RING_FORMAT));
+    autoAlignParam_ = dynamic_cast<juce::AudioParameterBool*>(apvts_.getParameter(GainStage::ParamIDs::AUTO_ALIGN));
+    tapIndexParam_ = dynamic_cast<juce::AudioParameterInt*>(apvts_.getParameter(GainStage::ParamIDs::TAP_INDEX));
+
+    apvts_.addParameterListener(GainStage::ParamIDs::MODE, this);
+    apvts_.addParameterListener(GainStage::ParamIDs::PAIR_ID, this);
+    apvts_.addParameterListener(GainStage::ParamIDs::TRANSPORT, this);
+    apvts_.addParameterListener(GainStage::ParamIDs::RING_FORMAT, this);
+    apvts_.addParameterListener(GainStage::ParamIDs::LATENCY_OFFSET, this);
+    apvts_.addParameterListener(GainStage::ParamIDs::AUTO_ALIGN, this);
+    apvts_.addParameterListener(GainStage::ParamIDs::TAP_INDEX, this);
+    apvts_.addParameterListener(GainStage::ParamIDs::MEASUREMENT_MODE, this);
 }
 
 UltimateGainStageAudioProcessor::~UltimateGainStageAudioProcessor()
 {
-    if (getInstanceMode() == GainStage::InstanceMode::Before)
-    {
-        GainStage::SharedBufferManager::getInstance().setBeforeInstanceInactive(getPairID());
-    }
+    apvts_.removeParameterListener(GainStage::ParamIDs::MODE, this);
+    apvts_.removeParameterListener(GainStage::ParamIDs::PAIR_ID, this);
+    apvts_.removeParameterListener(GainStage::ParamIDs::TRANSPORT, this);
+    apvts_.removeParameterListener(GainStage::ParamIDs::RING_FORMAT, this);
+    apvts_.removeParameterListener(GainStage::ParamIDs::LATENCY_OFFSET, this);
+    apvts_.removeParameterListener(GainStage::ParamIDs::AUTO_ALIGN, this);
+    apvts_.removeParameterListener(GainStage::ParamIDs::TAP_INDEX, this);
+    apvts_.removeParameterListener(GainStage::ParamIDs::MEASUREMENT_MODE, this);
+    cancelPendingUpdate();
+
+    releasePairBinding();
+    releaseTapBinding();
 }
 
 const juce::String UltimateGainStageAudioProcessor::getName() const
@@ -110,17 +134,42 @@ void UltimateGainStageAudioProcessor::prepareToPlay(double sampleRate, int sampl
     currentSampleRate_ = sampleRate;
     currentBlockSize_ = samplesPerBlock;
 
-    beforeAnalyzer_.prepare(sampleRate, samplesPerBlock);
-    afterAnalyzer_.prepare(sampleRate, samplesPerBlock);
-    deltaAnalyzer_.prepare(sampleRate, samplesPerBlock);
-    outputAnalyzer_.prepare(sampleRate, samplesPerBlock);
+    const int numChannels = getMainBusNumInputChannels();
+
+    for (auto* analyzer : { &beforeAnalyzer_, &afterAnalyzer_ })
+        analyzer->prepare(sampleRate, samplesPerBlock, numChannels, GainStage::kAnalyzerBinSize,
+                          GainStage::kMaxRMSWindowSeconds, getRMSDetector());
+
+    for (auto* analyzer : { &deltaAnalyzer_, &outputAnalyzer_ })
+        analyzer->prepare(sampleRate, samplesPerBlock, numChannels, GainStage::kAnalyzerBinSize,
+                          GainStage::kMaxRMSWindowSeconds);
     gainSmoother_.prepare(sampleRate);
 
-    referenceBuffer_.setSize(getTotalNumInputChannels(), samplesPerBlock);
+    for (auto& smoother : channelSmoothers_)
+    {
+        smoother.prepare(sampleRate);
+        smoother.reset();
+    }
+
+    referenceBufferLock_.release();
+    referenceScratchLock_.release();
+    deltaBufferLock_.release();
+
+    referenceBuffer_.setSize(numChannels, samplesPerBlock);
     referenceBuffer_.clear();
+    referenceScratch_.setSize(numChannels, samplesPerBlock);
+    referenceScratch_.clear();
+    deltaBuffer_.setSize(numChannels, samplesPerBlock);
+    referenceDelay_.prepare(numChannels);
+
+    referenceBufferLock_ = GainStage::RealtimeMemory::lockAudioBuffer(referenceBuffer_);
+    referenceScratchLock_ = GainStage::RealtimeMemory::lockAudioBuffer(referenceScratch_);
+    deltaBufferLock_ = GainStage::RealtimeMemory::lockAudioBuffer(deltaBuffer_);
 
-    int pairID = getPairID();
-    GainStage::SharedBufferManager::getInstance().prepareBuffer(pairID, sampleRate, getTotalNumInputChannels());
+    prepared_ = true;
+    updatePairBinding();
+    updateLatencyDetector();
+    writerLiveness_.reset();
 
     auto rmsWindow = static_cast<GainStage::RMSWindow>(rmsWindowParam_.load()->getIndex());
     int windowSamples = GainStage::rmsWindowToSamples(rmsWindow, sampleRate);
@@ -133,6 +182,11 @@ void UltimateGainStageAudioProcessor::prepareToPlay(double sampleRate, int sampl
 
 void UltimateGainStageAudioProcessor::releaseResources()
 {
+    const juce::ScopedLock lock(bindingLock_);
+    prepared_ = false;
+    releasePairBinding();
+    releaseTapBinding();
+    updateLatencyDetector();
 }
 
 #ifndef JucePlugin_PreferredChannelConfigurations
@@ -142,13 +196,22 @@ bool UltimateGainStageAudioProcessor::isBusesLayoutSupported(const BusesLayout&
     juce::ignoreUnused(layouts);
     return true;
 #else
-    if (layouts.getMainOutputChannelSet() != juce::AudioChannelSet::mono()
-        && layouts.getMainOutputChannelSet() != juce::AudioChannelSet::stereo())
+    const auto& mainOutput = layouts.getMainOutputChannelSet();
+
+    if (mainOutput.isDisabled() || mainOutput.size() > GainStage::kMaxChannels)
         return false;
 
 #if ! JucePlugin_IsSynth
     if (layouts.getMainOutputChannelSet() != layouts.getMainInputChannelSet())
         return false;
+
+    if (layouts.inputBuses.size() > 1)
+    {
+        const auto& sidechain = layouts.getChannelSet(true, 1);
+
+        if (! sidechain.isDisabled() && sidechain.size() != mainOutput.size())
+            return false;
+    }
 #endif
 
     return true;
@@ -172,13 +235,383 @@ int UltimateGainStageAudioProcessor::getPairID() const
 
 bool UltimateGainStageAudioProcessor::isPaired() const
 {
-    int pairID = getPairID();
     auto mode = getInstanceMode();
 
     if (mode == GainStage::InstanceMode::Before)
         return true;
 
-    return GainStage::SharedBufferManager::getInstance().isBeforeInstanceActive(pairID);
+    if (mode == GainStage::InstanceMode::Tap)
+        return tapBinding_.load() >= 0;
+
+    if (mode == GainStage::InstanceMode::Sidechain)
+        return sidechainConnected_.load();
+
+    return writerAlive_.load();
+}
+
+bool UltimateGainStageAudioProcessor::isPairFull() const
+{
+    const auto binding = loadPairBinding();
+    return getInstanceMode() == GainStage::InstanceMode::After && binding.isBound() && binding.readerSlot < 0;
+}
+
+bool UltimateGainStageAudioProcessor::isRingTooShort() const
+{
+    return loadPairBinding().isBound() && ringShortfall_.load() > 0;
+}
+
+GainStage::TransportType UltimateGainStageAudioProcessor::getTransportType() const
+{
+    if (auto* param = transportParam_.load())
+        if (static_cast<GainStage::TransportType>(param->getIndex()) == GainStage::TransportType::SharedMemory
+            && GainStage::SharedMemoryTransport::getInstance().isAvailable())
+            return GainStage::TransportType::SharedMemory;
+
+    return GainStage::TransportType::InProcess;
+}
+
+GainStage::PairTransport& UltimateGainStageAudioProcessor::PairBinding::getTransport(GainStage::TransportType type)
+{
+    if (type == GainStage::TransportType::SharedMemory)
+        return GainStage::SharedMemoryTransport::getInstance();
+
+    return GainStage::SharedBufferManager::getInstance();
+}
+
+int UltimateGainStageAudioProcessor::PairBinding::pack(const PairBinding& binding)
+{
+    if (! binding.isBound())
+        return kUnbound;
+
+    return (((binding.readerSlot + 1) * (GainStage::kMaxPairIDs + 1) + binding.pairID) * 2
+            + (binding.writer ? 1 : 0)) * 2
+         + static_cast<int>(binding.transport);
+}
+
+UltimateGainStageAudioProcessor::PairBinding UltimateGainStageAudioProcessor::PairBinding::unpack(int packed)
+{
+    PairBinding binding;
+
+    if (packed != kUnbound)
+    {
+        binding.transport = static_cast<GainStage::TransportType>(packed % 2);
+        binding.writer = (packed / 2) % 2 != 0;
+        binding.pairID = (packed / 4) % (GainStage::kMaxPairIDs + 1);
+        binding.readerSlot = (packed / 4) / (GainStage::kMaxPairIDs + 1) - 1;
+    }
+
+    return binding;
+}
+
+size_t UltimateGainStageAudioProcessor::getCommittedPairBytes() const
+{
+    return GainStage::SharedBufferManager::getInstance().getCommittedBytes()
+         + GainStage::SharedMemoryTransport::getInstance().getCommittedBytes();
+}
+
+UltimateGainStageAudioProcessor::Diagnostics UltimateGainStageAudioProcessor::getDiagnostics() const
+{
+    const auto binding = loadPairBinding();
+
+    Diagnostics diagnostics;
+    diagnostics.pair = binding.getTransport().getDiagnostics(binding.pairID, binding.readerSlot);
+    diagnostics.processedBlocks = processedBlocks_.load(std::memory_order_relaxed);
+    diagnostics.staleReferenceBlocks = staleReferenceBlocks_.load(std::memory_order_relaxed);
+    diagnostics.resamplerResyncs = resamplerResyncs_.load(std::memory_order_relaxed);
+    diagnostics.lastBlockSize = lastBlockSize_.load(std::memory_order_relaxed);
+    diagnostics.maxBlockSize = maxBlockSize_.load(std::memory_order_relaxed);
+    diagnostics.nonRealtime = nonRealtime_.load(std::memory_order_relaxed);
+    return diagnostics;
+}
+
+juce::String UltimateGainStageAudioProcessor::dumpDiagnostics() const
+{
+    const auto diagnostics = getDiagnostics();
+    const auto& pair = diagnostics.pair;
+
+    juce::String text;
+    auto line = [&text](const char* name, const juce::String& value) { text << name << ": " << value << juce::newLine; };
+
+    line("mode", modeParam_.load()->getCurrentChoiceName());
+    line("pairId", juce::String(getPairID()));
+    line("sampleRate", juce::String(currentSampleRate_));
+    const auto binding = loadPairBinding();
+    line("writerSampleRate", juce::String(binding.getTransport().getWriterSampleRate(binding.pairID)));
+    line("readerSlot", juce::String(binding.readerSlot));
+    line("ringCapacity", juce::String(binding.getTransport().getRingCapacity(binding.pairID))
+                             + " (short by " + juce::String(ringShortfall_.load()) + ")");
+    line("rendering", diagnostics.nonRealtime ? "offline" : "realtime");
+    line("levelKernels", GainStage::LevelKernels::get().name);
+    line("processedBlocks", juce::String(diagnostics.processedBlocks));
+    line("blockSize", juce::String(diagnostics.lastBlockSize) + " (max " + juce::String(diagnostics.maxBlockSize) + ")");
+    line("staleReferenceBlocks", juce::String(diagnostics.staleReferenceBlocks));
+    line("resamplerResyncs", juce::String(diagnostics.resamplerResyncs));
+    line("appliedLatency", juce::String(getAppliedLatency(), 3));
+    line("writerBlocks", juce::String(pair.writerBlocks));
+    line("writePosition", juce::String(pair.writePosition));
+    line("tornReads", juce::String(pair.tornReads));
+    line("fallbackReads", juce::String(pair.fallbackReads));
+
+    if (pair.valid)
+    {
+        line("readerBlocks", juce::String(pair.readerBlocks));
+        line("readsBeforeWrite", juce::String(pair.readsBeforeWrite));
+        line("audioReads", juce::String(pair.audioReads));
+        line("underruns", juce::String(pair.underruns));
+        line("overruns", juce::String(pair.overruns));
+        line("timelineMisses", juce::String(pair.timelineMisses));
+        line("blockLag", juce::String(pair.blockLag) + " (max " + juce::String(pair.maxBlockLag) + ")");
+        line("samplesBehind", juce::String(pair.samplesBehind) + " (max " + juce::String(pair.maxSamplesBehind) + ")");
+    }
+
+    return text;
+}
+
+void UltimateGainStageAudioProcessor::parameterChanged(const juce::String& parameterID, float newValue)
+{
+    juce::ignoreUnused(parameterID, newValue);
+
+    // May arrive on the audio thread; mapping or sizing the pair happens on the message thread.
+    triggerAsyncUpdate();
+}
+
+void UltimateGainStageAudioProcessor::handleAsyncUpdate()
+{
+    updatePairBinding();
+    updateLatencyDetector();
+    updateAnalyzerHistory();
+}
+
+void UltimateGainStageAudioProcessor::updatePairBinding()
+{
+    const juce::ScopedLock lock(bindingLock_);
+
+    if (! prepared_)
+        return;
+
+    if (getInstanceMode() == GainStage::InstanceMode::Tap)
+    {
+        releasePairBinding();
+        updateTapBinding();
+        return;
+    }
+
+    if (getInstanceMode() == GainStage::InstanceMode::Sidechain)
+    {
+        releasePairBinding();
+        releaseTapBinding();
+        return;
+    }
+
+    releaseTapBinding();
+
+    const auto transportType = getTransportType();
+    auto& transport = PairBinding::getTransport(transportType);
+    const int pairID = getPairID();
+    auto binding = loadPairBinding();
+
+    const bool isReader = getInstanceMode() == GainStage::InstanceMode::After;
+
+    if (binding.transport != transportType || binding.pairID != pairID)
+    {
+        transport.acquirePair(pairID);
+        releasePairBinding();
+
+        binding = { transportType, pairID, -1, ! isReader };
+        pairBinding_.store(PairBinding::pack(binding));
+    }
+    else if (binding.writer == isReader)
+    {
+        // Same pair, new role: a Before instance turning After stops writing here.
+        binding.writer = ! isReader;
+        pairBinding_.store(PairBinding::pack(binding));
+
+        if (isReader)
+            transport.setBeforeInstanceInactive(pairID);
+    }
+
+    // The writer owns the ring, so the Before instance's format is the one that counts.
+    if (! isReader)
+        transport.setRingFormat(pairID, static_cast<GainStage::RingFormat>(ringFormatParam_.load()->getIndex()));
+
+    // Sized for this instance's offset; the partner's prepare grows it if it needs more.
+    const double writerSampleRate = isReader ? transport.getWriterSampleRate(pairID) : currentSampleRate_;
+    const double ringScale = writerSampleRate > currentSampleRate_ ? writerSampleRate / currentSampleRate_ : 1.0;
+    const int latencyOffset = isReader && autoAlignParam_.load()->get() ? GainStage::ParamRanges::LATENCY_OFFSET_MAX
+                                                                        : latencyOffsetParam_.load()->get();
+
+    const int requiredRingSize = GainStage::getRequiredRingSize(currentSampleRate_ * ringScale,
+                                                                static_cast<int>(std::ceil(currentBlockSize_ * ringScale)),
+                                                                static_cast<int>(std::ceil(latencyOffset * ringScale)));
+
+    transport.prepareBuffer(pairID, getMainBusNumInputChannels(), requiredRingSize);
+    ringShortfall_.store(juce::jmax(0, requiredRingSize - transport.getRingCapacity(pairID)));
+
+    if (! isReader)
+        transport.setWriterSampleRate(pairID, currentSampleRate_);
+
+    updateResampler(isReader ? writerSampleRate : 0.0);
+
+    // A full pair is retried on the next update.
+    if (isReader && binding.readerSlot < 0)
+    {
+        binding.readerSlot = transport.registerReader(pairID);
+        pairBinding_.store(PairBinding::pack(binding));
+    }
+    else if (! isReader && binding.readerSlot >= 0)
+    {
+        const int readerSlot = binding.readerSlot;
+        binding.readerSlot = -1;
+        pairBinding_.store(PairBinding::pack(binding));
+        transport.unregisterReader(pairID, readerSlot);
+    }
+}
+
+void UltimateGainStageAudioProcessor::updateResampler(double writerSampleRate)
+{
+    std::unique_ptr<GainStage::ReferenceResampler> replacement;
+
+    if (GainStage::needsResampling(writerSampleRate, currentSampleRate_))
+    {
+        const int numChannels = getMainBusNumInputChannels();
+
+        if (resampler_ != nullptr
+            && resampler_->getSourceRate() == writerSampleRate
+            && resampler_->getTargetRate() == currentSampleRate_
+            && resampler_->getNumChannels() >= numChannels
+            && resampler_->getMaxOutputSamples() >= currentBlockSize_)
+            return;
+
+        replacement = std::make_unique<GainStage::ReferenceResampler>(writerSampleRate, currentSampleRate_,
+                                                                      numChannels, currentBlockSize_);
+    }
+    else if (resampler_ == nullptr)
+    {
+        return;
+    }
+
+    {
+        const juce::SpinLock::ScopedLockType lock(resamplerLock_);
+        std::swap(resampler_, replacement);
+        resamplePositionValid_ = false;
+    }
+}
+
+// Message thread only: starts and joins the detector's worker thread.
+void UltimateGainStageAudioProcessor::updateLatencyDetector()
+{
+    const bool shouldRun = prepared_
+        && getInstanceMode() == GainStage::InstanceMode::After
+        && autoAlignParam_.load()->get();
+
+    if (shouldRun == (latencyDetector_ != nullptr))
+        return;
+
+    auto replacement = shouldRun ? std::make_unique<GainStage::LatencyDetector>() : nullptr;
+
+    {
+        const juce::SpinLock::ScopedLockType lock(latencyDetectorLock_);
+        std::swap(latencyDetector_, replacement);
+    }
+}
+
+// Allocates a history before the audio thread switches an analyzer to Window, and frees it
+// once the audio thread has switched away.
+void UltimateGainStageAudioProcessor::updateAnalyzerHistory()
+{
+    if (! prepared_)
+        return;
+
+    const bool needsHistory = getRMSDetector() == GainStage::GainAnalyzer::Detector::Window;
+
+    for (auto* analyzer : { &beforeAnalyzer_, &afterAnalyzer_ })
+    {
+        const juce::SpinLock::ScopedLockType lock(analyzerHistoryLock_);
+
+        if (analyzer->getDetector() == GainStage::GainAnalyzer::Detector::Window || analyzer->hasHistory() == needsHistory)
+            continue;
+
+        if (needsHistory)
+            analyzer->allocateHistory();
+        else
+            analyzer->releaseHistory();
+    }
+}
+
+void UltimateGainStageAudioProcessor::releasePairBinding()
+{
+    const juce::ScopedLock lock(bindingLock_);
+    const auto binding = PairBinding::unpack(pairBinding_.exchange(kUnbound));
+
+    if (! binding.isBound())
+        return;
+
+    auto& transport = binding.getTransport();
+
+    if (binding.readerSlot >= 0)
+        transport.unregisterReader(binding.pairID, binding.readerSlot);
+
+    if (binding.writer)
+        transport.setBeforeInstanceInactive(binding.pairID);
+
+    transport.releasePair(binding.pairID);
+}
+
+// Taps reuse the pair ID as their chain ID and TAP_INDEX as their position on it.
+void UltimateGainStageAudioProcessor::updateTapBinding()
+{
+    const juce::ScopedLock lock(bindingLock_);
+
+    auto& registry = GainStage::TapChainRegistry::getInstance();
+    const int chainID = getPairID();
+    const int ordinal = tapIndexParam_.load()->get();
+    const int binding = tapBinding_.load();
+
+    if (binding >= 0 && binding / GainStage::kMaxTaps == chainID)
+    {
+        registry.setOrdinal(chainID, binding % GainStage::kMaxTaps, ordinal);
+        return;
+    }
+
+    releaseTapBinding();
+
+    const int slot = registry.acquireTap(chainID, ordinal);
+    if (slot >= 0)
+        tapBinding_.store(chainID * GainStage::kMaxTaps + slot);
+}
+
+void UltimateGainStageAudioProcessor::releaseTapBinding()
+{
+    const juce::ScopedLock lock(bindingLock_);
+
+    // Cleared before the registry waits for the chain's guard to go idle.
+    const int binding = tapBinding_.exchange(-1);
+
+    if (binding >= 0)
+        GainStage::TapChainRegistry::getInstance().releaseTap(binding / GainStage::kMaxTaps, binding % GainStage::kMaxTaps);
+}
+
+std::vector<GainStage::TapInfo> UltimateGainStageAudioProcessor::getTapChain() const
+{
+    return GainStage::TapChainRegistry::getInstance().getTaps(getPairID());
+}
+
+int UltimateGainStageAudioProcessor::getTapSlot() const
+{
+    const int binding = tapBinding_.load();
+    return binding >= 0 ? binding % GainStage::kMaxTaps : -1;
+}
+
+bool UltimateGainStageAudioProcessor::bindToNamedPair(const juce::String& name)
+{
+    const int pairID = GainStage::SharedBufferManager::getInstance().assignPairName(name);
+    if (pairID == 0)
+        return false;
+
+    if (auto* param = pairIdParam_.load())
+        param->setValueNotifyingHost(param->convertTo0to1(static_cast<float>(pairID)));
+
+    return true;
 }
 
 void UltimateGainStageAudioProcessor::processBlock(juce::AudioBuffer<float>& buffer, juce::MidiBuffer& midiMessages)
@@ -189,66 +622,314 @@ void UltimateGainStageAudioProcessor::processBlock(juce::AudioBuffer<float>& buf
     auto totalNumInputChannels = getTotalNumInputChannels();
     auto totalNumOutputChannels = getTotalNumOutputChannels();
 
+    GainStage::RingProtocol::bump(processedBlocks_);
+    lastBlockSize_.store(buffer.getNumSamples(), std::memory_order_relaxed);
+    if (buffer.getNumSamples() > maxBlockSize_.load(std::memory_order_relaxed))
+        maxBlockSize_.store(buffer.getNumSamples(), std::memory_order_relaxed);
+    nonRealtime_.store(isNonRealtime(), std::memory_order_relaxed);
+
     for (auto i = totalNumInputChannels; i < totalNumOutputChannels; ++i)
         buffer.clear(i, 0, buffer.getNumSamples());
 
     if (bypassParam_.load()->get())
         return;
 
+    auto mainBuffer = getBusBuffer(buffer, false, 0);
+
     float inputGaindB = inputGainParam_.load()->get();
     if (std::abs(inputGaindB) > 0.001f)
     {
         float inputGainLinear = juce::Decibels::decibelsToGain(inputGaindB);
-        buffer.applyGain(inputGainLinear);
+        mainBuffer.applyGain(inputGainLinear);
     }
 
+    // Buffers are allocated for the prepared block size, so longer host blocks are chunked.
     auto mode = getInstanceMode();
-    if (mode == GainStage::InstanceMode::Before)
-    {
-        processBeforeMode(buffer);
-    }
-    else
+    auto sidechainBuffer = mode == GainStage::InstanceMode::Sidechain ? getBusBuffer(buffer, true, 1)
+                                                                      : juce::AudioBuffer<float>();
+    const int numSamples = mainBuffer.getNumSamples();
+
+    for (int start = 0; start < numSamples; start += currentBlockSize_)
     {
-        processAfterMode(buffer);
+        const int chunkSize = juce::jmin(currentBlockSize_, numSamples - start);
+        juce::AudioBuffer<float> chunk(mainBuffer.getArrayOfWritePointers(), mainBuffer.getNumChannels(), start, chunkSize);
+        chunkOffset_ = start;
+
+        if (mode == GainStage::InstanceMode::Before)
+        {
+            processBeforeMode(chunk);
+        }
+        else if (mode == GainStage::InstanceMode::Tap)
+        {
+            processTapMode(chunk);
+        }
+        else if (mode == GainStage::InstanceMode::Sidechain)
+        {
+            juce::AudioBuffer<float> sidechainChunk(sidechainBuffer.getArrayOfWritePointers(),
+                                                    sidechainBuffer.getNumChannels(), start, chunkSize);
+            processSidechainMode(chunk, sidechainChunk);
+        }
+        else
+        {
+            processAfterMode(chunk);
+        }
     }
+
+    chunkOffset_ = 0;
+}
+
+juce::int64 UltimateGainStageAudioProcessor::getTimelinePosition() const
+{
+    // Only a running timeline gives unambiguous stamps.
+    if (auto* playHead = getPlayHead())
+        if (auto position = playHead->getPosition())
+            if (position->getIsPlaying() || position->getIsRecording())
+                if (auto timeInSamples = position->getTimeInSamples())
+                    return *timeInSamples + chunkOffset_;
+
+    return GainStage::kNoTimelinePosition;
 }
 
 void UltimateGainStageAudioProcessor::processBeforeMode(juce::AudioBuffer<float>& buffer)
 {
-    int pairID = getPairID();
+    // Only a writer binding writes; the mode can change before the binding catches up.
+    const auto binding = loadPairBinding();
+    const int pairID = binding.writer ? binding.pairID : 0;
+    auto& transport = binding.getTransport();
 
-    GainStage::SharedBufferManager::getInstance().writeSamples(pairID, buffer, buffer.getNumSamples());
+    transport.writeSamples(pairID, buffer, buffer.getNumSamples(), getTimelinePosition());
 
     beforeAnalyzer_.process(buffer);
     beforeLeveldB_.store(beforeAnalyzer_.getRMSdB());
+
+    GainStage::BlockStats stats;
+    stats.numChannels = juce::jmin(buffer.getNumChannels(), GainStage::kMaxChannels);
+    stats.numSamples = buffer.getNumSamples();
+
+    for (int ch = 0; ch < stats.numChannels; ++ch)
+    {
+        stats.sumSquares[static_cast<size_t>(ch)] = beforeAnalyzer_.getBlockSumSquares(ch);
+        stats.peaks[static_cast<size_t>(ch)] = beforeAnalyzer_.getBlockPeak(ch);
+    }
+
+    transport.writeStats(pairID, stats);
+
+    // A release or role change that raced this block must not leave the flag set.
+    const auto current = loadPairBinding();
+
+    if (pairID > 0 && (! current.writer || current.pairID != pairID || current.transport != binding.transport))
+        transport.setBeforeInstanceInactive(pairID);
 }
 
-void UltimateGainStageAudioProcessor::processAfterMode(juce::AudioBuffer<float>& buffer)
+void UltimateGainStageAudioProcessor::processTapMode(juce::AudioBuffer<float>& buffer)
 {
-    int pairID = getPairID();
-    int numSamples = buffer.getNumSamples();
-    int latencyOffset = latencyOffsetParam_.load()->get();
+    auto rmsWindow = static_cast<GainStage::RMSWindow>(rmsWindowParam_.load()->getIndex());
+    beforeAnalyzer_.setRMSWindowSamples(GainStage::rmsWindowToSamples(rmsWindow, currentSampleRate_));
+    applyRMSDetector();
+
+    beforeAnalyzer_.process(buffer);
+    beforeLeveldB_.store(beforeAnalyzer_.getRMSdB());
 
+    const int binding = tapBinding_.load();
+    if (binding < 0)
+        return;
+
+    // Re-checked inside the access, so a slot released meanwhile is never written to.
+    const auto chain = GainStage::TapChainRegistry::getInstance().access(binding / GainStage::kMaxTaps);
+    if (chain && tapBinding_.load() == binding)
+        chain->publish(binding % GainStage::kMaxTaps, beforeAnalyzer_.getRMSdB(), beforeAnalyzer_.getPeakdB());
+}
+
+void UltimateGainStageAudioProcessor::updateMeasurementSettings()
+{
     auto rmsWindow = static_cast<GainStage::RMSWindow>(rmsWindowParam_.load()->getIndex());
     int windowSamples = GainStage::rmsWindowToSamples(rmsWindow, currentSampleRate_);
     beforeAnalyzer_.setRMSWindowSamples(windowSamples);
     afterAnalyzer_.setRMSWindowSamples(windowSamples);
+    applyRMSDetector();
 
     gainSmoother_.setAttackTime(attackTimeParam_.load()->get());
     gainSmoother_.setReleaseTime(releaseTimeParam_.load()->get());
+}
+
+// Audio thread. Keeps the current detector for a block while the history is being swapped,
+// and until a Window detector's history has been allocated.
+void UltimateGainStageAudioProcessor::applyRMSDetector()
+{
+    const auto detector = getRMSDetector();
+
+    if (beforeAnalyzer_.getDetector() == detector && afterAnalyzer_.getDetector() == detector)
+        return;
+
+    const juce::SpinLock::ScopedTryLockType lock(analyzerHistoryLock_);
+
+    if (! lock.isLocked())
+        return;
+
+    const bool beforeSwitched = beforeAnalyzer_.setDetector(detector);
+    const bool afterSwitched = afterAnalyzer_.setDetector(detector);
+
+    if (! beforeSwitched || ! afterSwitched || detector == GainStage::GainAnalyzer::Detector::Exponential)
+        triggerAsyncUpdate();
+}
+
+GainStage::GainAnalyzer::Detector UltimateGainStageAudioProcessor::getRMSDetector() const
+{
+    return static_cast<GainStage::MeasurementMode>(measurementModeParam_.load()->getIndex())
+                   == GainStage::MeasurementMode::RMSExponential
+               ? GainStage::GainAnalyzer::Detector::Exponential
+               : GainStage::GainAnalyzer::Detector::Window;
+}
+
+// The host aligns the sidechain, so the reference is measured where it is.
+void UltimateGainStageAudioProcessor::processSidechainMode(juce::AudioBuffer<float>& buffer,
+                                                           const juce::AudioBuffer<float>& sidechain)
+{
+    updateMeasurementSettings();
+
+    const bool connected = sidechain.getNumChannels() >= buffer.getNumChannels() && buffer.getNumChannels() > 0;
+    sidechainConnected_.store(connected);
+
+    if (connected)
+        beforeAnalyzer_.process(sidechain);
+
+    compensateAgainstReference(buffer, connected ? &sidechain : nullptr, connected);
+}
+
+void UltimateGainStageAudioProcessor::processAfterMode(juce::AudioBuffer<float>& buffer)
+{
+    const auto binding = loadPairBinding();
+    const int pairID = binding.pairID;
+    int numSamples = buffer.getNumSamples();
+    int latencyOffset = latencyOffsetParam_.load()->get();
+
+    updateMeasurementSettings();
+
+    jassert(numSamples <= referenceBuffer_.getNumSamples() && numSamples <= referenceScratch_.getNumSamples());
+
+    auto& transport = binding.getTransport();
+    const int readerSlot = binding.readerSlot;
+
+    bool listenBefore = listenBeforeParam_.load()->get();
+    bool deltaEnabled = deltaEnabledParam_.load()->get();
+    bool deltaSolo = deltaSoloParam_.load()->get();
+
+    // Raw reference audio is only requested while it is played, subtracted or aligned.
+    const bool autoAlign = autoAlignParam_.load()->get();
+    const bool needsAudio = listenBefore || deltaEnabled || deltaSolo || autoAlign;
+    transport.setReaderNeedsAudio(pairID, readerSlot, needsAudio);
+
+    // Auto-align leaves the last 1 to 2 samples of delay to the fractional delay.
+    const float appliedLatency = updateAppliedLatency(latencyOffset, autoAlign);
+    const int readOffset = autoAlign ? juce::jmax(0, static_cast<int>(appliedLatency) - 1) : latencyOffset;
+
+    // The writer counts in its own samples; other rates are resampled on the way in.
+    const double writerSampleRate = transport.getWriterSampleRate(pairID);
+    const bool resampling = GainStage::needsResampling(writerSampleRate, currentSampleRate_);
+    const int writerLatencyOffset = resampling ? juce::roundToInt(readOffset * writerSampleRate / currentSampleRate_)
+                                               : readOffset;
+
+    GainStage::BlockStats referenceStats;
+    const bool hasNewStats = transport.readStats(pairID, readerSlot, writerLatencyOffset, referenceStats);
+
+    if (hasNewStats && resampling)
+    {
+        const double ratio = currentSampleRate_ / writerSampleRate;
+        referenceStats.numSamples = juce::roundToInt(referenceStats.numSamples * ratio);
+
+        for (auto& sum : referenceStats.sumSquares)
+            sum = static_cast<float>(sum * ratio);
+    }
+
+    // Only audio that gets played needs copying out of the ring.
+    const bool needsContiguousAudio = listenBefore || deltaEnabled || deltaSolo || resampling;
+    GainStage::RingProtocol::RingView view;
+
+    const float detectorDelay = needsContiguousAudio ? appliedLatency : static_cast<float>(readOffset);
+
+    if (needsAudio && ! needsContiguousAudio
+        && transport.beginView(pairID, numSamples, readOffset, getTimelinePosition(), readerSlot, view))
+    {
+        beforeAnalyzer_.process(view.first.data(), view.second.data(), view.numChannels, view.firstLength, numSamples);
+
+        const juce::SpinLock::ScopedTryLockType lock(latencyDetectorLock_);
+        auto* detector = lock.isLocked() ? latencyDetector_.get() : nullptr;
+
+        if (detector != nullptr)
+            detector->push(view.first.data(), view.second.data(), view.numChannels, view.firstLength,
+                           buffer, numSamples, detectorDelay);
+
+        // A torn view costs the meters one mixed block, but the detector's frame can't keep it.
+        if (! transport.endView(view))
+        {
+            GainStage::RingProtocol::bump(staleReferenceBlocks_);
+
+            if (detector != nullptr)
+                detector->restartFrame();
+        }
+    }
+    else if (needsAudio)
+    {
+        const bool complete = resampling
+            ? readResampledReference(transport, pairID, readerSlot, numSamples, writerLatencyOffset, writerSampleRate)
+            : transport.readSamples(pairID, referenceScratch_, numSamples, readOffset, getTimelinePosition(), readerSlot);
+
+        if (complete)
+        {
+            if (autoAlign && needsContiguousAudio)
+                referenceDelay_.process(referenceScratch_, numSamples, appliedLatency - static_cast<float>(readOffset));
+
+            std::swap(referenceBuffer_, referenceScratch_);
+        }
+        else
+        {
+            GainStage::RingProtocol::bump(staleReferenceBlocks_);
+        }
+
+        beforeAnalyzer_.process(referenceBuffer_, numSamples);
+
+        if (autoAlign)
+        {
+            const juce::SpinLock::ScopedTryLockType lock(latencyDetectorLock_);
+
+            if (lock.isLocked() && latencyDetector_ != nullptr)
+            {
+                if (complete)
+                    latencyDetector_->push(referenceBuffer_, buffer, numSamples, detectorDelay);
+                else
+                    latencyDetector_->restartFrame();
+            }
+        }
+    }
+    else if (hasNewStats)
+    {
+        beforeAnalyzer_.processStats(referenceStats.sumSquares.data(), referenceStats.peaks.data(),
+                                     referenceStats.numChannels, referenceStats.numSamples);
+    }
 
-    if (referenceBuffer_.getNumSamples() < numSamples)
-        referenceBuffer_.setSize(buffer.getNumChannels(), numSamples, false, true, true);
+    writerLiveness_.setTimeoutSamples(pairTimeoutParam_.load()->get());
+    writerAlive_.store(writerLiveness_.update(transport.getWriterBlockCount(pairID),
+                                             transport.isBeforeInstanceActive(pairID), numSamples));
 
-    GainStage::SharedBufferManager::getInstance().readSamples(pairID, referenceBuffer_, numSamples, latencyOffset);
+    compensateAgainstReference(buffer, &referenceBuffer_, writerAlive_.load());
+}
+
+// reference, when given, holds at least buffer's channels and samples.
+void UltimateGainStageAudioProcessor::compensateAgainstReference(juce::AudioBuffer<float>& buffer,
+                                                                 const juce::AudioBuffer<float>* reference, bool paired)
+{
+    const int numSamples = buffer.getNumSamples();
+
+    bool listenBefore = listenBeforeParam_.load()->get() && reference != nullptr;
+    bool deltaEnabled = deltaEnabledParam_.load()->get() && reference != nullptr;
+    bool deltaSolo = deltaSoloParam_.load()->get() && reference != nullptr;
 
-    beforeAnalyzer_.process(referenceBuffer_);
     afterAnalyzer_.process(buffer);
 
     auto measurementMode = static_cast<GainStage::MeasurementMode>(measurementModeParam_.load()->getIndex());
     float beforeLevel, afterLevel;
 
-    if (measurementMode == GainStage::MeasurementMode::RMS)
+    if (measurementMode != GainStage::MeasurementMode::Peak)
     {
         beforeLevel = beforeAnalyzer_.getRMSdB();
         afterLevel = afterAnalyzer_.getRMSdB();
@@ -265,24 +946,54 @@ void UltimateGainStageAudioProcessor::processAfterMode(juce::AudioBuffer<float>&
     float tolerance = toleranceParam_.load()->get();
     float gainDifference = beforeLevel - afterLevel;
 
-    bool shouldCompensate = std::abs(gainDifference) > tolerance && isPaired();
-    isCompensating_.store(shouldCompensate);
+    bool shouldCompensate = std::abs(gainDifference) > tolerance && paired;
 
     float targetGaindB = shouldCompensate ? gainDifference : 0.0f;
     targetGaindB = juce::jlimit(-40.0f, 40.0f, targetGaindB);
 
     float smoothedGaindB = gainSmoother_.process(targetGaindB);
-    gainReductiondB_.store(smoothedGaindB);
+    const int numChannels = juce::jmin(buffer.getNumChannels(), GainStage::kMaxChannels);
 
-    bool listenBefore = listenBeforeParam_.load()->get();
-    bool deltaEnabled = deltaEnabledParam_.load()->get();
-    bool deltaSolo = deltaSoloParam_.load()->get();
+    auto compensationMode = static_cast<GainStage::CompensationMode>(compensationModeParam_.load()->getIndex());
+    if (compensationMode == GainStage::CompensationMode::PerChannel)
+    {
+        const bool useRMS = measurementMode != GainStage::MeasurementMode::Peak;
+        float gainSum = 0.0f;
+        shouldCompensate = false;
+
+        for (int ch = 0; ch < numChannels; ++ch)
+        {
+            auto& smoother = channelSmoothers_[static_cast<size_t>(ch)];
+            smoother.setAttackTime(attackTimeParam_.load()->get());
+            smoother.setReleaseTime(releaseTimeParam_.load()->get());
+
+            float channelDifference = useRMS
+                ? beforeAnalyzer_.getChannelRMSdB(ch) - afterAnalyzer_.getChannelRMSdB(ch)
+                : beforeAnalyzer_.getChannelPeakdB(ch) - afterAnalyzer_.getChannelPeakdB(ch);
+
+            bool channelCompensates = std::abs(channelDifference) > tolerance && paired;
+            shouldCompensate = shouldCompensate || channelCompensates;
+
+            float channelTarget = juce::jlimit(-40.0f, 40.0f, channelCompensates ? channelDifference : 0.0f);
+            compensationGainsdB_[static_cast<size_t>(ch)] = smoother.process(channelTarget);
+            gainSum += compensationGainsdB_[static_cast<size_t>(ch)];
+        }
+
+        smoothedGaindB = numChannels > 0 ? gainSum / static_cast<float>(numChannels) : 0.0f;
+    }
+    else
+    {
+        std::fill(compensationGainsdB_.begin(), compensationGainsdB_.end(), smoothedGaindB);
+    }
+
+    isCompensating_.store(shouldCompensate);
+    gainReductiondB_.store(smoothedGaindB);
 
     if (listenBefore)
     {
         for (int ch = 0; ch < buffer.getNumChannels(); ++ch)
         {
-            buffer.copyFrom(ch, 0, referenceBuffer_, ch, 0, numSamples);
+            buffer.copyFrom(ch, 0, *reference, ch, 0, numSamples);
         }
     }
     else if (deltaEnabled || deltaSolo)
@@ -290,40 +1001,33 @@ void UltimateGainStageAudioProcessor::processAfterMode(juce::AudioBuffer<float>&
         float deltaGaindB = deltaGainParam_.load()->get();
         float deltaGainLinear = juce::Decibels::decibelsToGain(deltaGaindB);
 
-        juce::AudioBuffer<float> deltaBuffer(buffer.getNumChannels(), numSamples);
+        const int numDeltaChannels = juce::jmin(buffer.getNumChannels(), deltaBuffer_.getNumChannels());
+        const auto& kernels = GainStage::LevelKernels::get();
 
-        for (int ch = 0; ch < buffer.getNumChannels(); ++ch)
+        for (int ch = 0; ch < numDeltaChannels; ++ch)
         {
-            float* deltaData = deltaBuffer.getWritePointer(ch);
-            const float* afterData = buffer.getReadPointer(ch);
-            const float* beforeData = referenceBuffer_.getReadPointer(ch);
-
-            for (int i = 0; i < numSamples; ++i)
-            {
-                deltaData[i] = (afterData[i] - beforeData[i]) * deltaGainLinear;
-            }
+            kernels.difference(buffer.getReadPointer(ch), reference->getReadPointer(ch), deltaGainLinear,
+                               deltaBuffer_.getWritePointer(ch), numSamples);
         }
 
-        deltaAnalyzer_.process(deltaBuffer);
+        deltaAnalyzer_.process(deltaBuffer_, numSamples);
         deltaLeveldB_.store(deltaAnalyzer_.getRMSdB());
 
         if (deltaSolo)
         {
-            for (int ch = 0; ch < buffer.getNumChannels(); ++ch)
+            for (int ch = 0; ch < numDeltaChannels; ++ch)
             {
-                buffer.copyFrom(ch, 0, deltaBuffer, ch, 0, numSamples);
+                buffer.copyFrom(ch, 0, deltaBuffer_, ch, 0, numSamples);
             }
         }
         else
         {
-            float compensationGain = juce::Decibels::decibelsToGain(smoothedGaindB);
-            buffer.applyGain(compensationGain);
+            applyCompensation(buffer, numSamples);
         }
     }
     else
     {
-        float compensationGain = juce::Decibels::decibelsToGain(smoothedGaindB);
-        buffer.applyGain(compensationGain);
+        applyCompensation(buffer, numSamples);
     }
 
     float outputGaindB = outputGainParam_.load()->get();
@@ -338,6 +1042,9 @@ void UltimateGainStageAudioProcessor::processAfterMode(juce::AudioBuffer<float>&
     for (int ch = 0; ch < buffer.getNumChannels(); ++ch)
     {
         float* data = buffer.getWritePointer(ch);
+        if (GainStage::LevelKernels::get().peak(data, numSamples) <= 1.0f)
+            continue;
+
         for (int i = 0; i < numSamples; ++i)
         {
             if (std::abs(data[i]) > 1.0f)
@@ -354,6 +1061,101 @@ void UltimateGainStageAudioProcessor::processAfterMode(juce::AudioBuffer<float>&
     outputLeveldB_.store(outputAnalyzer_.getRMSdB());
 }
 
+// The manual offset, or with auto-align the detector's estimate once it moves enough.
+float UltimateGainStageAudioProcessor::updateAppliedLatency(int manualOffset, bool autoAlign)
+{
+    constexpr float hysteresis = 0.1f;
+
+    if (autoAlign != autoAligned_.exchange(autoAlign))
+        referenceDelay_.reset();
+
+    if (! autoAlign)
+    {
+        appliedLatency_ = static_cast<float>(manualOffset);
+    }
+    else
+    {
+        const juce::SpinLock::ScopedTryLockType lock(latencyDetectorLock_);
+
+        if (lock.isLocked() && latencyDetector_ != nullptr)
+        {
+            const float estimate = latencyDetector_->getEstimate();
+
+            if (estimate != GainStage::LatencyDetector::kNoEstimate && std::abs(estimate - appliedLatency_) > hysteresis)
+                appliedLatency_ = juce::jlimit(0.0f, static_cast<float>(GainStage::ParamRanges::LATENCY_OFFSET_MAX), estimate);
+        }
+    }
+
+    appliedLatencyDisplay_.store(appliedLatency_);
+    return appliedLatency_;
+}
+
+// Resampled reads follow the writer's stream by position rather than by timeline.
+bool UltimateGainStageAudioProcessor::readResampledReference(GainStage::PairTransport& transport, int pairID, int readerSlot,
+                                                             int numSamples, int latencyOffset, double writerSampleRate)
+{
+    const juce::SpinLock::ScopedTryLockType lock(resamplerLock_);
+
+    if (! lock.isLocked())
+        return false;
+
+    if (resampler_ == nullptr || resampler_->getSourceRate() != writerSampleRate)
+    {
+        triggerAsyncUpdate();
+        return false;
+    }
+
+    auto& resampler = *resampler_;
+    numSamples = juce::jmin(numSamples, resampler.getMaxOutputSamples());
+
+    const double step = resampler.getStep();
+    const int inputSpan = resampler.getInputSpan(numSamples);
+    constexpr int leadIn = GainStage::ReferenceResampler::kHalfTaps - 1;
+
+    const double target = static_cast<double>(transport.getWritePosition(pairID))
+                        - latencyOffset - inputSpan + leadIn;
+
+    // Resynced when scheduling jitter exceeds a block or the offset changes.
+    if (! resamplePositionValid_ || latencyOffset != resampleLatencyOffset_
+        || std::abs(resamplePosition_ - target) > (numSamples + currentBlockSize_) * step)
+    {
+        resamplePosition_ = target;
+        resampleLatencyOffset_ = latencyOffset;
+        resamplePositionValid_ = true;
+        GainStage::RingProtocol::bump(resamplerResyncs_);
+    }
+
+    const double start = std::floor(resamplePosition_);
+    const double fraction = resamplePosition_ - start;
+    resamplePosition_ += numSamples * step;
+
+    if (start < leadIn)
+        return false;
+
+    const int numChannels = juce::jmin(referenceScratch_.getNumChannels(), resampler.getNumChannels());
+    std::array<float*, GainStage::kMaxChannels> inputs{};
+
+    for (int ch = 0; ch < numChannels; ++ch)
+        inputs[static_cast<size_t>(ch)] = resampler.getInputChannel(ch);
+
+    if (! transport.readSamplesAt(pairID, inputs.data(), numChannels, static_cast<uint64_t>(start) - leadIn, inputSpan,
+                                  readerSlot))
+        return false;
+
+    for (int ch = 0; ch < numChannels; ++ch)
+        resampler.process(ch, referenceScratch_.getWritePointer(ch), numSamples, fraction);
+
+    return true;
+}
+
+void UltimateGainStageAudioProcessor::applyCompensation(juce::AudioBuffer<float>& buffer, int numSamples)
+{
+    const int numChannels = juce::jmin(buffer.getNumChannels(), GainStage::kMaxChannels);
+
+    for (int ch = 0; ch < numChannels; ++ch)
+        buffer.applyGain(ch, 0, numSamples, juce::Decibels::decibelsToGain(compensationGainsdB_[static_cast<size_t>(ch)]));
+}
+
 bool UltimateGainStageAudioProcessor::hasEditor() const
 {
     return true;
@@ -367,6 +1169,7 @@ juce::AudioProcessorEditor* UltimateGainStageAudioProcessor::createEditor()
 void UltimateGainStageAudioProcessor::getStateInformation(juce::MemoryBlock& destData)
 {
     auto state = apvts_.copyState();
+    state.setProperty(GainStage::STATE_VERSION, GainStage::kStateVersion, nullptr);
     std::unique_ptr<juce::XmlElement> xml(state.createXml());
     copyXmlToBinary(*xml, destData);
 }
@@ -379,6 +1182,7 @@ void UltimateGainStageAudioProcessor::setStateInformation(const void* data, int
     {
         if (xmlState->hasTagName(apvts_.state.getType()))
         {
+            GainStage::migrateState(*xmlState);
             apvts_.replaceState(juce::ValueTree::fromXml(*xmlState));
         }
     }
@@ -2,10 +2,16 @@
 
 #include <JuceHeader.h>
 #include "SharedBuffer.h"
+#include "SharedMemoryTransport.h"
 #include "Parameters.h"
 #include "GainAnalyzer.h"
+#include "ReferenceResampler.h"
+#include "LatencyDetector.h"
+#include "TapChain.h"
 
-class UltimateGainStageAudioProcessor : public juce::AudioProcessor
+class UltimateGainStageAudioProcessor : public juce::AudioProcessor,
+                                        private juce::AudioProcessorValueTreeState::Listener,
+                                        private juce::AsyncUpdater
 {
 public:
     UltimateGainStageAudioProcessor();
@@ -44,6 +50,24 @@ public:
     GainStage::InstanceMode getInstanceMode() const;
     int getPairID() const;
     bool isPaired() const;
+    // An After instance bound to a pair whose reader slots are all taken.
+    bool isPairFull() const;
+    // The pair's ring holds less than this instance's latency offset and block size need,
+    // because a shared-memory partner created it smaller.
+    bool isRingTooShort() const;
+    // The selected transport, falling back to in-process where shared memory isn't available.
+    GainStage::TransportType getTransportType() const;
+
+    // Ring and control memory held for pairs in this process, across both transports.
+    // Message thread only.
+    size_t getCommittedPairBytes() const;
+
+    // Audio-thread memory this process currently holds page-locked.
+    size_t getLockedMemoryBytes() const { return GainStage::RealtimeMemory::getLockedBytes(); }
+
+    // Binds this instance to the pair carrying the given name, claiming a free pair ID for
+    // it if no other instance uses that name yet. Message thread only.
+    bool bindToNamedPair(const juce::String& name);
 
     float getBeforeLeveldB() const { return beforeLeveldB_.load(); }
     float getAfterLeveldB() const { return afterLeveldB_.load(); }
@@ -54,9 +78,60 @@ public:
     bool isClipping() const { return isClipping_.load(); }
     bool isWarning() const { return std::abs(gainReductiondB_.load()) > 10.0f; }
 
+    // Scheduling and reference-freshness counters for this instance and, in After mode, its
+    // reader slot on the pair. Sampled wait-free; counts run from the last pair binding.
+    struct Diagnostics
+    {
+        GainStage::PairDiagnostics pair;
+        uint64_t processedBlocks = 0;
+        // After blocks that kept the previous reference because the read didn't complete.
+        uint64_t staleReferenceBlocks = 0;
+        uint64_t resamplerResyncs = 0;
+        int lastBlockSize = 0;
+        int maxBlockSize = 0;
+        bool nonRealtime = false;
+    };
+
+    Diagnostics getDiagnostics() const;
+
+    // getDiagnostics() as text, one counter per line, for bug reports.
+    juce::String dumpDiagnostics() const;
+
+    // Reference delay the After instance currently applies, in samples; fractional while
+    // auto-align is on.
+    float getAppliedLatency() const { return appliedLatencyDisplay_.load(); }
+    bool isAutoAligned() const { return autoAligned_.load(); }
+
+    // Every tap on this instance's chain, in chain order. Message thread only.
+    std::vector<GainStage::TapInfo> getTapChain() const;
+    // This instance's slot on its chain, or -1 if it isn't a bound tap.
+    int getTapSlot() const;
+
 private:
+    void parameterChanged(const juce::String& parameterID, float newValue) override;
+    void handleAsyncUpdate() override;
+
+    void updatePairBinding();
+    void releasePairBinding();
+    void updateResampler(double writerSampleRate);
+    void updateLatencyDetector();
+    void updateAnalyzerHistory();
+    void updateTapBinding();
+    void releaseTapBinding();
+
+    juce::int64 getTimelinePosition() const;
     void processBeforeMode(juce::AudioBuffer<float>& buffer);
     void processAfterMode(juce::AudioBuffer<float>& buffer);
+    void processSidechainMode(juce::AudioBuffer<float>& buffer, const juce::AudioBuffer<float>& sidechain);
+    void updateMeasurementSettings();
+    void applyRMSDetector();
+    GainStage::GainAnalyzer::Detector getRMSDetector() const;
+    void compensateAgainstReference(juce::AudioBuffer<float>& buffer, const juce::AudioBuffer<float>* reference, bool paired);
+    void processTapMode(juce::AudioBuffer<float>& buffer);
+    float updateAppliedLatency(int manualOffset, bool autoAlign);
+    bool readResampledReference(GainStage::PairTransport& transport, int pairID, int readerSlot, int numSamples,
+                                int latencyOffset, double writerSampleRate);
+    void applyCompensation(juce::AudioBuffer<float>& buffer, int numSamples);
 
     juce::AudioProcessorValueTreeState apvts_;
 
@@ -76,17 +151,90 @@ private:
     std::atomic<juce::AudioParameterBool*> listenBeforeParam_{ nullptr };
     std::atomic<juce::AudioParameterBool*> listenAfterParam_{ nullptr };
     std::atomic<juce::AudioParameterInt*> latencyOffsetParam_{ nullptr };
+    std::atomic<juce::AudioParameterChoice*> transportParam_{ nullptr };
+    std::atomic<juce::AudioParameterChoice*> compensationModeParam_{ nullptr };
+    std::atomic<juce::AudioParameterInt*> pairTimeoutParam_{ nullptr };
+    std::atomic<juce::AudioParameterChoice*> ringFormatParam_{ nullptr };
+    std::atomic<juce::AudioParameterBool*> autoAlignParam_{ nullptr };
+    std::atomic<juce::AudioParameterInt*> tapIndexParam_{ nullptr };
+
+    // The pair this instance holds a reference on, its reader slot, and whether it
+    // writes the pair (so the Before flag is cleared from the role it was bound in).
+    struct PairBinding
+    {
+        GainStage::TransportType transport = GainStage::TransportType::InProcess;
+        int pairID = 0;
+        int readerSlot = -1;
+        bool writer = false;
+
+        bool isBound() const { return pairID > 0; }
+        GainStage::PairTransport& getTransport() const { return getTransport(transport); }
+
+        static GainStage::PairTransport& getTransport(GainStage::TransportType type);
+        static int pack(const PairBinding& binding);
+        static PairBinding unpack(int packed);
+    };
+
+    PairBinding loadPairBinding() const { return PairBinding::unpack(pairBinding_.load()); }
+
+    // Changed on the message thread under bindingLock_. Packed into one word, like
+    // tapBinding_, so the audio thread never uses a slot with another pair or transport;
+    // kUnbound while unbound.
+    static constexpr int kUnbound = -1;
+    juce::CriticalSection bindingLock_;
+    std::atomic<int> pairBinding_{ kUnbound };
+    // Chain ID and slot of a bound tap packed into one word, so the audio thread never pairs
+    // a slot with the wrong chain; -1 while unbound.
+    std::atomic<int> tapBinding_{ -1 };
+    // Samples this instance asked of the pair's ring beyond what it got; set with the binding.
+    std::atomic<int> ringShortfall_{ 0 };
 
     double currentSampleRate_ = 48000.0;
     int currentBlockSize_ = 512;
+    // Pair rings are only sized and allocated between prepareToPlay and releaseResources.
+    bool prepared_ = false;
 
     GainStage::GainAnalyzer beforeAnalyzer_;
     GainStage::GainAnalyzer afterAnalyzer_;
+    // The before and after analyzers only keep a history for the Window detector. It is
+    // allocated and freed on the message thread under analyzerHistoryLock_, while the
+    // analyzer is off Window; the audio thread try-locks to change detector.
+    juce::SpinLock analyzerHistoryLock_;
     GainStage::GainAnalyzer deltaAnalyzer_;
     GainStage::GainAnalyzer outputAnalyzer_;
     GainStage::GainSmoother gainSmoother_;
+    std::array<GainStage::GainSmoother, GainStage::kMaxChannels> channelSmoothers_;
+    std::array<float, GainStage::kMaxChannels> compensationGainsdB_{};
 
+    // Reads land in referenceScratch_ and are swapped in only when complete, so a torn
+    // read leaves the previous block in referenceBuffer_.
     juce::AudioBuffer<float> referenceBuffer_;
+    juce::AudioBuffer<float> referenceScratch_;
+    juce::AudioBuffer<float> deltaBuffer_;
+
+    // Keep the buffers above resident; the locks cover memory, so they stay valid when the
+    // two reference buffers swap contents.
+    GainStage::RealtimeMemory::LockedRegion referenceBufferLock_;
+    GainStage::RealtimeMemory::LockedRegion referenceScratchLock_;
+    GainStage::RealtimeMemory::LockedRegion deltaBufferLock_;
+
+    // Only exists while the Before instance runs at another rate. Replaced on the message
+    // thread under resamplerLock_; the audio thread try-locks and skips a block if it can't.
+    juce::SpinLock resamplerLock_;
+    std::unique_ptr<GainStage::ReferenceResampler> resampler_;
+    // Stream position in the writer's samples, owned by the audio thread.
+    double resamplePosition_ = 0.0;
+    int resampleLatencyOffset_ = 0;
+    bool resamplePositionValid_ = false;
+
+    // Runs only while an After instance has auto-align on; swapped like the resampler.
+    juce::SpinLock latencyDetectorLock_;
+    std::unique_ptr<GainStage::LatencyDetector> latencyDetector_;
+    GainStage::FractionalDelay referenceDelay_;
+    // Audio thread only.
+    float appliedLatency_ = 0.0f;
+    // Where the chunk being processed starts in the host's block; audio thread only.
+    int chunkOffset_ = 0;
 
     std::atomic<float> beforeLeveldB_{ -100.0f };
     std::atomic<float> afterLeveldB_{ -100.0f };
@@ -95,6 +243,21 @@ private:
     std::atomic<float> outputLeveldB_{ -100.0f };
     std::atomic<bool> isCompensating_{ false };
     std::atomic<bool> isClipping_{ false };
+    std::atomic<float> appliedLatencyDisplay_{ 0.0f };
+    std::atomic<bool> autoAligned_{ false };
+
+    // Written only by the audio thread.
+    std::atomic<uint64_t> processedBlocks_{ 0 };
+    std::atomic<uint64_t> staleReferenceBlocks_{ 0 };
+    std::atomic<uint64_t> resamplerResyncs_{ 0 };
+    std::atomic<int> lastBlockSize_{ 0 };
+    std::atomic<int> maxBlockSize_{ 0 };
+    std::atomic<bool> nonRealtime_{ false };
+
+    GainStage::WriterLiveness writerLiveness_;
+    std::atomic<bool> writerAlive_{ false };
+    // Sidechain mode: the host delivered a sidechain bus wide enough to compare against.
+    std::atomic<bool> sidechainConnected_{ false };
 
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(UltimateGainStageAudioProcessor)
 };
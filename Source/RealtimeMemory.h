@@ -0,0 +1,241 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+#if JUCE_LINUX || JUCE_MAC || JUCE_BSD
+ #include <sys/mman.h>
+ #include <unistd.h>
+ #define GAINSTAGE_HAS_MLOCK 1
+#else
+ #define GAINSTAGE_HAS_MLOCK 0
+#endif
+
+// Set to 0 to only pre-fault audio-thread memory without page-locking it.
+#ifndef GAINSTAGE_LOCK_AUDIO_MEMORY
+ #define GAINSTAGE_LOCK_AUDIO_MEMORY 1
+#endif
+
+namespace GainStage
+{
+    // Keeps memory the audio thread touches resident, so it never takes a page fault.
+    namespace RealtimeMemory
+    {
+        inline std::atomic<size_t>& getLockedBytesCounter()
+        {
+            static std::atomic<size_t> lockedBytes{ 0 };
+            return lockedBytes;
+        }
+
+        // Bytes currently mlock'ed by this process through LockedRegion, in whole pages; a
+        // page shared by several regions counts once.
+        inline size_t getLockedBytes()
+        {
+            return getLockedBytesCounter().load(std::memory_order_relaxed);
+        }
+
+        inline size_t getPageSize()
+        {
+           #if GAINSTAGE_HAS_MLOCK
+            static const size_t pageSize = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+            return pageSize;
+           #else
+            return 4096;
+           #endif
+        }
+
+        // Touches every page of the range. Writing faults in private memory for real (a read
+        // would only map the shared zero page); it stores back the byte it read, so it's only
+        // for memory no other thread is using yet. Shared mappings can be touched by reading.
+        inline void prefault(void* data, size_t numBytes, bool touchByWriting)
+        {
+            if (data == nullptr || numBytes == 0)
+                return;
+
+            auto* bytes = static_cast<volatile char*>(data);
+            const size_t pageSize = getPageSize();
+
+            for (size_t offset = 0; offset < numBytes; offset += pageSize)
+            {
+                const char value = bytes[offset];
+                if (touchByWriting)
+                    bytes[offset] = value;
+            }
+
+            const char last = bytes[numBytes - 1];
+            if (touchByWriting)
+                bytes[numBytes - 1] = last;
+        }
+
+       #if GAINSTAGE_HAS_MLOCK && GAINSTAGE_LOCK_AUDIO_MEMORY
+        // The OS keeps one lock bit per page, so regions sharing a page would unlock it for
+        // each other. Pages are counted here instead: a page is mlocked when its first region
+        // takes it and munlocked when its last one lets go.
+        class PageLocks
+        {
+        public:
+            static PageLocks& getInstance()
+            {
+                static PageLocks instance;
+                return instance;
+            }
+
+            // Takes every page in [firstPage, endPage), or none of them if one can't be locked.
+            bool acquire(uintptr_t firstPage, uintptr_t endPage)
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                const auto pageSize = getPageSize();
+                std::vector<std::pair<uintptr_t, uintptr_t>> newlyLocked;
+
+                for (uintptr_t page = firstPage; page < endPage;)
+                {
+                    if (counts_.count(page) != 0)
+                    {
+                        page += pageSize;
+                        continue;
+                    }
+
+                    auto runEnd = page + pageSize;
+                    while (runEnd < endPage && counts_.count(runEnd) == 0)
+                        runEnd += pageSize;
+
+                    if (mlock(reinterpret_cast<void*>(page), runEnd - page) != 0)
+                    {
+                        for (const auto& run : newlyLocked)
+                            munlock(reinterpret_cast<void*>(run.first), run.second - run.first);
+
+                        return false;
+                    }
+
+                    newlyLocked.emplace_back(page, runEnd);
+                    page = runEnd;
+                }
+
+                for (uintptr_t page = firstPage; page < endPage; page += pageSize)
+                    ++counts_[page];
+
+                for (const auto& run : newlyLocked)
+                    getLockedBytesCounter().fetch_add(run.second - run.first, std::memory_order_relaxed);
+
+                return true;
+            }
+
+            void release(uintptr_t firstPage, uintptr_t endPage)
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                const auto pageSize = getPageSize();
+
+                for (uintptr_t page = firstPage; page < endPage; page += pageSize)
+                {
+                    auto entry = counts_.find(page);
+                    if (entry == counts_.end() || --entry->second > 0)
+                        continue;
+
+                    counts_.erase(entry);
+                    munlock(reinterpret_cast<void*>(page), pageSize);
+                    getLockedBytesCounter().fetch_sub(pageSize, std::memory_order_relaxed);
+                }
+            }
+
+        private:
+            std::mutex mutex_;
+            // Regions holding each locked page, keyed by page address.
+            std::map<uintptr_t, int> counts_;
+        };
+       #endif
+
+        // Pre-faults a range and mlocks its pages for as long as this object lives. Locking
+        // fails quietly when the platform or RLIMIT_MEMLOCK doesn't allow it; the pages are
+        // then still resident, just pageable. Pages shared with other regions stay locked
+        // until the last of them is released. Off the audio thread.
+        class LockedRegion
+        {
+        public:
+            LockedRegion() = default;
+
+            LockedRegion(void* data, size_t numBytes, bool touchByWriting = true)
+                : data_(data), numBytes_(numBytes)
+            {
+                prefault(data, numBytes, touchByWriting);
+
+               #if GAINSTAGE_HAS_MLOCK && GAINSTAGE_LOCK_AUDIO_MEMORY
+                if (data != nullptr && numBytes > 0)
+                    locked_ = PageLocks::getInstance().acquire(getFirstPage(), getEndPage());
+               #endif
+            }
+
+            ~LockedRegion()
+            {
+                release();
+            }
+
+            LockedRegion(LockedRegion&& other) noexcept
+                : data_(std::exchange(other.data_, nullptr)),
+                  numBytes_(std::exchange(other.numBytes_, 0)),
+                  locked_(std::exchange(other.locked_, false))
+            {
+            }
+
+            LockedRegion& operator=(LockedRegion&& other) noexcept
+            {
+                if (this != &other)
+                {
+                    release();
+                    data_ = std::exchange(other.data_, nullptr);
+                    numBytes_ = std::exchange(other.numBytes_, 0);
+                    locked_ = std::exchange(other.locked_, false);
+                }
+
+                return *this;
+            }
+
+            LockedRegion(const LockedRegion&) = delete;
+            LockedRegion& operator=(const LockedRegion&) = delete;
+
+            bool isLocked() const { return locked_; }
+
+            void release()
+            {
+               #if GAINSTAGE_HAS_MLOCK && GAINSTAGE_LOCK_AUDIO_MEMORY
+                if (locked_)
+                    PageLocks::getInstance().release(getFirstPage(), getEndPage());
+               #endif
+
+                data_ = nullptr;
+                numBytes_ = 0;
+                locked_ = false;
+            }
+
+        private:
+            uintptr_t getFirstPage() const
+            {
+                return reinterpret_cast<uintptr_t>(data_) & ~(getPageSize() - 1);
+            }
+
+            uintptr_t getEndPage() const
+            {
+                return (reinterpret_cast<uintptr_t>(data_) + numBytes_ + getPageSize() - 1) & ~(getPageSize() - 1);
+            }
+
+            void* data_ = nullptr;
+            size_t numBytes_ = 0;
+            bool locked_ = false;
+        };
+
+        // JUCE allocates an AudioBuffer's channels back to back, so one region covers them all.
+        inline LockedRegion lockAudioBuffer(juce::AudioBuffer<float>& buffer)
+        {
+            if (buffer.getNumChannels() == 0 || buffer.getNumSamples() == 0)
+                return {};
+
+            auto* first = reinterpret_cast<char*>(buffer.getWritePointer(0));
+            auto* end = reinterpret_cast<char*>(buffer.getWritePointer(buffer.getNumChannels() - 1) + buffer.getNumSamples());
+
+            return LockedRegion(first, static_cast<size_t>(end - first));
+        }
+    }
+}
@@ -0,0 +1,144 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include <vector>
+#include <cmath>
+#include "RealtimeMemory.h"
+
+namespace GainStage
+{
+    // True when a pair's two ends run at rates far enough apart to need resampling. An
+    // unknown rate (0) never does.
+    inline bool needsResampling(double sourceRate, double targetRate)
+    {
+        return sourceRate > 0.0 && targetRate > 0.0 && std::abs(sourceRate - targetRate) > 1.0e-6 * targetRate;
+    }
+
+    // Streaming windowed-sinc resampler for reference audio recorded at another rate, e.g.
+    // when one instance of a pair sits inside an oversampled container. The kernel comes from
+    // a polyphase table built once per rate pair, and each output sample blends the two
+    // nearest phases. The caller tracks the stream position and fills getInputChannel() with
+    // the input span around it every block, so this holds no history of its own.
+    // Built off the audio thread; process() is wait-free.
+    class ReferenceResampler
+    {
+    public:
+        static constexpr int kHalfTaps = 8;
+        static constexpr int kTaps = 2 * kHalfTaps;
+        static constexpr int kPhases = 256;
+
+        ReferenceResampler(double sourceRate, double targetRate, int numChannels, int maxOutputSamples)
+            : sourceRate_(sourceRate),
+              targetRate_(targetRate),
+              step_(sourceRate / targetRate),
+              numChannels_(juce::jmax(1, numChannels)),
+              maxOutputSamples_(juce::jmax(1, maxOutputSamples)),
+              inputCapacity_(getInputSpan(maxOutputSamples_))
+        {
+            buildTable();
+
+            input_.assign(static_cast<size_t>(inputCapacity_) * static_cast<size_t>(numChannels_), 0.0f);
+            inputLock_ = RealtimeMemory::LockedRegion(input_.data(), input_.size() * sizeof(float));
+            tableLock_ = RealtimeMemory::LockedRegion(table_.data(), table_.size() * sizeof(float));
+        }
+
+        double getSourceRate() const { return sourceRate_; }
+        double getTargetRate() const { return targetRate_; }
+
+        // Source samples advanced per output sample.
+        double getStep() const { return step_; }
+
+        int getNumChannels() const { return numChannels_; }
+        int getMaxOutputSamples() const { return maxOutputSamples_; }
+
+        // Source samples needed for numOutput samples: from kHalfTaps - 1 before the first
+        // output's integer position to kHalfTaps after the last one's.
+        int getInputSpan(int numOutput) const
+        {
+            return static_cast<int>(std::ceil(static_cast<double>(numOutput) * step_)) + kTaps + 1;
+        }
+
+        float* getInputChannel(int channel)
+        {
+            return input_.data() + static_cast<size_t>(channel) * static_cast<size_t>(inputCapacity_);
+        }
+
+        // Input sample j of the channel is source position floor(start) - (kHalfTaps - 1) + j,
+        // and fraction is start - floor(start).
+        void process(int channel, float* dest, int numOutput, double fraction) const
+        {
+            const float* input = input_.data() + static_cast<size_t>(channel) * static_cast<size_t>(inputCapacity_);
+            numOutput = juce::jmin(numOutput, maxOutputSamples_);
+
+            double position = fraction;
+
+            for (int i = 0; i < numOutput; ++i)
+            {
+                const int base = static_cast<int>(position);
+                const double phasePosition = (position - base) * kPhases;
+                const int phase = static_cast<int>(phasePosition);
+                const auto mix = static_cast<float>(phasePosition - phase);
+
+                const float* lower = table_.data() + static_cast<size_t>(phase) * kTaps;
+                const float* upper = lower + kTaps;
+                const float* x = input + base;
+
+                float a = 0.0f, b = 0.0f;
+                for (int k = 0; k < kTaps; ++k)
+                {
+                    a += x[k] * lower[k];
+                    b += x[k] * upper[k];
+                }
+
+                dest[i] = a + (b - a) * mix;
+                position += step_;
+            }
+        }
+
+    private:
+        // kPhases + 1 rows so the last phase can blend towards the next integer position.
+        // The cutoff sits just under the lower of the two Nyquist frequencies, and each row is
+        // normalised to unity DC gain so levels aren't shifted by the kernel.
+        void buildTable()
+        {
+            const double cutoff = 0.95 * juce::jmin(1.0, 1.0 / step_);
+            table_.assign(static_cast<size_t>(kPhases + 1) * kTaps, 0.0f);
+
+            for (int phase = 0; phase <= kPhases; ++phase)
+            {
+                const double fraction = static_cast<double>(phase) / kPhases;
+                float* row = table_.data() + static_cast<size_t>(phase) * kTaps;
+                double sum = 0.0;
+
+                for (int k = 0; k < kTaps; ++k)
+                {
+                    const double x = k - (kHalfTaps - 1) - fraction;
+                    const double window = 0.42 + 0.5 * std::cos(juce::MathConstants<double>::pi * x / kHalfTaps)
+                                        + 0.08 * std::cos(juce::MathConstants<double>::twoPi * x / kHalfTaps);
+                    const double arg = juce::MathConstants<double>::pi * cutoff * x;
+                    const double sinc = std::abs(arg) < 1.0e-9 ? 1.0 : std::sin(arg) / arg;
+                    const double tap = std::abs(x) >= kHalfTaps ? 0.0 : cutoff * sinc * window;
+
+                    row[k] = static_cast<float>(tap);
+                    sum += tap;
+                }
+
+                if (sum > 0.0)
+                    for (int k = 0; k < kTaps; ++k)
+                        row[k] = static_cast<float>(row[k] / sum);
+            }
+        }
+
+        const double sourceRate_;
+        const double targetRate_;
+        const double step_;
+        const int numChannels_;
+        const int maxOutputSamples_;
+        const int inputCapacity_;
+
+        std::vector<float> table_;
+        std::vector<float> input_;
+        RealtimeMemory::LockedRegion tableLock_;
+        RealtimeMemory::LockedRegion inputLock_;
+    };
+}
@@ -0,0 +1,230 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include <cstdint>
+#include <cstring>
+#include "Parameters.h"
+#include "LevelKernels.h"
+
+#if GAINSTAGE_X86 && defined(_MSC_VER)
+ #include <intrin.h>
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+ #include <arm_neon.h>
+#endif
+
+namespace GainStage
+{
+    // Chunk length, in samples, sharing one scale factor in the scaled 16-bit format.
+    constexpr int kScaleChunkSize = 64;
+
+    inline int getBytesPerSample(RingFormat format)
+    {
+        return format == RingFormat::Float32 ? 4 : 2;
+    }
+
+    // Float <-> reduced-precision conversion for reference rings.
+    //
+    // Accuracy on measured levels:
+    //  - Float16 keeps 11 significant bits, so each sample is within 2^-11 relative, i.e. RMS
+    //    and peak levels within about 0.004 dB. Below 2^-14 (-84 dBFS) samples become
+    //    subnormal and lose precision, and below 2^-24 (-144 dBFS) they flush to zero, far
+    //    under the meter floor.
+    //  - ScaledInt16 quantises each kScaleChunkSize-sample chunk against its own peak, so the
+    //    error is at most half a step of peak / 32767, about -96 dB relative to the chunk's
+    //    loudest sample. Levels within 40 dB of the chunk peak are effectively exact, and
+    //    the format has no absolute floor the way Float16 does.
+    namespace SampleConversion
+    {
+        // Round-to-nearest-even, with overflow to infinity and NaN preserved.
+        inline uint16_t floatToHalf(float value)
+        {
+            uint32_t bits;
+            std::memcpy(&bits, &value, sizeof(bits));
+
+            const auto sign = static_cast<uint16_t>((bits >> 16) & 0x8000u);
+            bits &= 0x7fffffffu;
+
+            if (bits >= 0x47800000u)
+                return static_cast<uint16_t>(sign | (bits > 0x7f800000u ? 0x7e00u : 0x7c00u));
+
+            if (bits < 0x38800000u)
+            {
+                // Adding 0.5f lines the value up so the float addition itself rounds to the
+                // half subnormal grid.
+                float shifted;
+                std::memcpy(&shifted, &bits, sizeof(shifted));
+                shifted += 0.5f;
+                std::memcpy(&bits, &shifted, sizeof(bits));
+                return static_cast<uint16_t>(sign | (bits - 0x3f000000u));
+            }
+
+            bits += 0xc8000fffu + ((bits >> 13) & 1u);
+            return static_cast<uint16_t>(sign | (bits >> 13));
+        }
+
+        inline float halfToFloat(uint16_t half)
+        {
+            uint32_t bits = static_cast<uint32_t>(half & 0x7fffu) << 13;
+            const uint32_t exponent = bits & 0x0f800000u;
+
+            bits += (127u - 15u) << 23;
+
+            if (exponent == 0x0f800000u)
+            {
+                bits += (128u - 16u) << 23;
+            }
+            else if (exponent == 0)
+            {
+                bits += 1u << 23;
+                float value;
+                std::memcpy(&value, &bits, sizeof(value));
+                value -= 6.103515625e-05f; // 2^-14
+                std::memcpy(&bits, &value, sizeof(bits));
+            }
+
+            bits |= static_cast<uint32_t>(half & 0x8000u) << 16;
+
+            float result;
+            std::memcpy(&result, &bits, sizeof(result));
+            return result;
+        }
+
+       #if GAINSTAGE_X86
+        // F16C arrived after AVX on every x86 CPU, so the conversions are built for both.
+        namespace F16C
+        {
+            GAINSTAGE_TARGET("avx,f16c")
+            inline void floatToHalf(const float* src, uint16_t* dest, int numSamples)
+            {
+                int i = 0;
+
+                for (; i + 8 <= numSamples; i += 8)
+                    _mm_storeu_si128(reinterpret_cast<__m128i*>(dest + i),
+                                     _mm256_cvtps_ph(_mm256_loadu_ps(src + i), _MM_FROUND_TO_NEAREST_INT));
+
+                for (; i < numSamples; ++i)
+                    dest[i] = SampleConversion::floatToHalf(src[i]);
+            }
+
+            GAINSTAGE_TARGET("avx,f16c")
+            inline void halfToFloat(const uint16_t* src, float* dest, int numSamples)
+            {
+                int i = 0;
+
+                for (; i + 8 <= numSamples; i += 8)
+                    _mm256_storeu_ps(dest + i, _mm256_cvtph_ps(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i))));
+
+                for (; i < numSamples; ++i)
+                    dest[i] = SampleConversion::halfToFloat(src[i]);
+            }
+
+            inline bool isSupported()
+            {
+                if (! juce::SystemStats::hasAVX())
+                    return false;
+
+               #if defined(_MSC_VER)
+                int info[4] {};
+                __cpuid(info, 1);
+                return (info[2] & (1 << 29)) != 0;
+               #else
+                return __builtin_cpu_supports("f16c") != 0;
+               #endif
+            }
+        }
+       #endif
+
+        namespace Scalar
+        {
+            inline void floatToHalf(const float* src, uint16_t* dest, int numSamples)
+            {
+                int i = 0;
+
+               #if defined(__aarch64__) && defined(__ARM_NEON)
+                for (; i + 4 <= numSamples; i += 4)
+                    vst1_u16(dest + i, vreinterpret_u16_f16(vcvt_f16_f32(vld1q_f32(src + i))));
+               #endif
+
+                for (; i < numSamples; ++i)
+                    dest[i] = SampleConversion::floatToHalf(src[i]);
+            }
+
+            inline void halfToFloat(const uint16_t* src, float* dest, int numSamples)
+            {
+                int i = 0;
+
+               #if defined(__aarch64__) && defined(__ARM_NEON)
+                for (; i + 4 <= numSamples; i += 4)
+                    vst1q_f32(dest + i, vcvt_f32_f16(vreinterpret_f16_u16(vld1_u16(src + i))));
+               #endif
+
+                for (; i < numSamples; ++i)
+                    dest[i] = SampleConversion::halfToFloat(src[i]);
+            }
+        }
+
+        // Block converters, picked like LevelKernels::get(): once per process, from what the
+        // CPU supports rather than what the build targets. NEON is part of every aarch64 CPU,
+        // so the scalar entry uses it directly.
+        struct HalfConverters
+        {
+            const char* name;
+            void (*floatToHalf)(const float* src, uint16_t* dest, int numSamples);
+            void (*halfToFloat)(const uint16_t* src, float* dest, int numSamples);
+        };
+
+        inline HalfConverters selectHalfConverters()
+        {
+           #if GAINSTAGE_X86
+            if (F16C::isSupported())
+                return { "F16C", F16C::floatToHalf, F16C::halfToFloat };
+           #endif
+
+            return { "Scalar", Scalar::floatToHalf, Scalar::halfToFloat };
+        }
+
+        // Rings fetch this when they are built, so the CPU query never lands on the audio thread.
+        inline const HalfConverters& getHalfConverters()
+        {
+            static const HalfConverters converters = selectHalfConverters();
+            return converters;
+        }
+
+        inline void floatToHalf(const float* src, uint16_t* dest, int numSamples)
+        {
+            getHalfConverters().floatToHalf(src, dest, numSamples);
+        }
+
+        inline void halfToFloat(const uint16_t* src, float* dest, int numSamples)
+        {
+            getHalfConverters().halfToFloat(src, dest, numSamples);
+        }
+
+        // Branch-free bodies so the compiler can vectorise them.
+        inline void quantise(const float* src, int16_t* dest, int numSamples, float scale)
+        {
+            const float inverse = scale > 0.0f ? 1.0f / scale : 0.0f;
+
+            for (int i = 0; i < numSamples; ++i)
+            {
+                const float scaled = src[i] * inverse;
+                dest[i] = static_cast<int16_t>(scaled + (scaled >= 0.0f ? 0.5f : -0.5f));
+            }
+        }
+
+        inline void dequantise(const int16_t* src, float* dest, int numSamples, float scale)
+        {
+            for (int i = 0; i < numSamples; ++i)
+                dest[i] = static_cast<float>(src[i]) * scale;
+        }
+
+        inline void rescale(int16_t* samples, int numSamples, float ratio)
+        {
+            for (int i = 0; i < numSamples; ++i)
+            {
+                const float scaled = static_cast<float>(samples[i]) * ratio;
+                samples[i] = static_cast<int16_t>(scaled + (scaled >= 0.0f ? 0.5f : -0.5f));
+            }
+        }
+    }
+}
@@ -5,51 +5,1138 @@
 #include <array>
 #include <map>
 #include <mutex>
+#include <thread>
+#include <limits>
+#include "Parameters.h"
+#include "SampleFormat.h"
+#include "RealtimeMemory.h"
 
 namespace GainStage
 {
-    constexpr int kMaxPairIDs = 16;
-    constexpr int kMaxChannels = 2;
-    constexpr float kBufferLengthSeconds = 1.0f;
+    constexpr int kMaxPairIDs = ParamRanges::PAIR_ID_MAX;
+    constexpr int kMaxChannels = 16;
+    // Headroom on top of the latency offset for hosts that run the two instances out of step.
+    constexpr float kRingSlackSeconds = 0.1f;
+    constexpr int kMaxReadAttempts = 3;
+    constexpr int kBlockStampCount = 64;
+    constexpr int kMaxReaders = 8;
+    constexpr int kStatsBlockCount = 256;
+    // Apple silicon prefetches cache lines in pairs, so hot atomics sit twice a line apart.
+   #if JUCE_MAC && JUCE_ARM
+    constexpr size_t kCacheLineSize = 128;
+   #else
+    constexpr size_t kCacheLineSize = 64;
+   #endif
+    constexpr juce::int64 kNoTimelinePosition = std::numeric_limits<juce::int64>::min();
 
-    struct SharedAudioData
+    // The latency offset, a block either side, and scheduling slack.
+    inline int getRequiredRingSize(double sampleRate, int maxBlockSize, int latencyOffset)
     {
-        static constexpr int kDefaultBufferSize = 48000;
+        return juce::jmax(0, latencyOffset) + 2 * juce::jmax(1, maxBlockSize)
+             + static_cast<int>(sampleRate * kRingSlackSeconds);
+    }
 
-        std::array<std::vector<float>, kMaxChannels> channelBuffers;
-        std::atomic<int> writePosition{ 0 };
+    // Channel-planar ring memory, owned (in-process) or viewing a shared segment. Immutable
+    // once published; samples are stored in format, ScaledInt16 with per-chunk scales.
+    struct RingStorage
+    {
+        RingStorage(int minSize, int channels, RingFormat formatToUse = RingFormat::Float32)
+            : bufferSize(juce::nextPowerOfTwo(juce::jmax(kScaleChunkSize, minSize))),
+              bufferMask(bufferSize - 1),
+              numChannels(juce::jlimit(1, kMaxChannels, channels)),
+              format(formatToUse)
+        {
+            const auto channelBytes = static_cast<size_t>(bufferSize) * static_cast<size_t>(getBytesPerSample(format));
+            ownedSamples_.resize(channelBytes * static_cast<size_t>(numChannels) / sizeof(float), 0.0f);
+
+            if (format == RingFormat::ScaledInt16)
+                ownedScales_.resize(static_cast<size_t>(getNumScaleChunks()) * static_cast<size_t>(numChannels), 0.0f);
+
+            assignChannels(ownedSamples_.data(), ownedScales_.data());
+            getTotalOwnedBytes().fetch_add(getAllocatedBytes());
+
+            samplesLock_ = RealtimeMemory::LockedRegion(ownedSamples_.data(), ownedSamples_.size() * sizeof(float));
+            scalesLock_ = RealtimeMemory::LockedRegion(ownedScales_.data(), ownedScales_.size() * sizeof(float));
+        }
+
+        ~RingStorage()
+        {
+            getTotalOwnedBytes().fetch_sub(getAllocatedBytes());
+        }
+
+        RingStorage(const RingStorage&) = delete;
+        RingStorage& operator=(const RingStorage&) = delete;
+
+        static std::atomic<size_t>& getTotalOwnedBytes()
+        {
+            static std::atomic<size_t> total{ 0 };
+            return total;
+        }
+
+        // externalScales is only read for ScaledInt16 and needs getNumScaleChunks() floats per channel.
+        RingStorage(void* externalSamples, float* externalScales, int size, int channels, RingFormat formatToUse)
+            : bufferSize(size),
+              bufferMask(size - 1),
+              numChannels(juce::jlimit(1, kMaxChannels, channels)),
+              format(formatToUse)
+        {
+            jassert(juce::isPowerOfTwo(size) && size >= kScaleChunkSize);
+            assignChannels(externalSamples, externalScales);
+        }
+
+        int getNumScaleChunks() const { return bufferSize / kScaleChunkSize; }
+
+        size_t getAllocatedBytes() const
+        {
+            return (ownedSamples_.size() + ownedScales_.size()) * sizeof(float);
+        }
+
+        void copyToRing(int channel, uint64_t pos, const float* src, int numSamples)
+        {
+            const int start = static_cast<int>(pos & static_cast<uint64_t>(bufferMask));
+            const int firstRun = juce::jmin(numSamples, bufferSize - start);
+
+            encode(channel, start, src, firstRun);
+            if (numSamples > firstRun)
+                encode(channel, 0, src + firstRun, numSamples - firstRun);
+        }
+
+        void copyFromRing(int channel, float* dest, uint64_t pos, int numSamples) const
+        {
+            const int start = static_cast<int>(pos & static_cast<uint64_t>(bufferMask));
+            const int firstRun = juce::jmin(numSamples, bufferSize - start);
+
+            decode(channel, start, dest, firstRun);
+            if (numSamples > firstRun)
+                decode(channel, 0, dest + firstRun, numSamples - firstRun);
+        }
+
+        // Forgets the scales of the chunk holding pos, so later samples aren't quantised to them.
+        void resetChunkScales(uint64_t pos)
+        {
+            if (format != RingFormat::ScaledInt16)
+                return;
+
+            const auto chunk = static_cast<size_t>((pos & static_cast<uint64_t>(bufferMask)) / kScaleChunkSize);
+
+            for (int ch = 0; ch < numChannels; ++ch)
+                channelScales[static_cast<size_t>(ch)][chunk] = 0.0f;
+        }
+
+        const int bufferSize;
+        const int bufferMask;
+        const int numChannels;
+        const RingFormat format;
+        std::array<void*, kMaxChannels> channelData{};
+        std::array<float*, kMaxChannels> channelScales{};
+
+    private:
+        void assignChannels(void* samples, float* scales)
+        {
+            const auto channelBytes = static_cast<size_t>(bufferSize) * static_cast<size_t>(getBytesPerSample(format));
+
+            for (int ch = 0; ch < numChannels; ++ch)
+            {
+                channelData[ch] = static_cast<char*>(samples) + static_cast<size_t>(ch) * channelBytes;
+
+                if (format == RingFormat::ScaledInt16)
+                    channelScales[ch] = scales + static_cast<size_t>(ch) * static_cast<size_t>(getNumScaleChunks());
+            }
+
+            if (format == RingFormat::Float16)
+                SampleConversion::getHalfConverters();
+        }
+
+        void encode(int channel, int start, const float* src, int numSamples)
+        {
+            switch (format)
+            {
+                case RingFormat::Float16:
+                    SampleConversion::floatToHalf(src, static_cast<uint16_t*>(channelData[channel]) + start, numSamples);
+                    break;
+
+                case RingFormat::ScaledInt16:
+                    encodeScaled(channel, start, src, numSamples);
+                    break;
+
+                case RingFormat::Float32:
+                default:
+                    juce::FloatVectorOperations::copy(static_cast<float*>(channelData[channel]) + start, src, numSamples);
+                    break;
+            }
+        }
+
+        void decode(int channel, int start, float* dest, int numSamples) const
+        {
+            switch (format)
+            {
+                case RingFormat::Float16:
+                    SampleConversion::halfToFloat(static_cast<const uint16_t*>(channelData[channel]) + start, dest, numSamples);
+                    break;
+
+                case RingFormat::ScaledInt16:
+                {
+                    const auto* samples = static_cast<const int16_t*>(channelData[channel]);
+
+                    while (numSamples > 0)
+                    {
+                        const int run = juce::jmin(numSamples, kScaleChunkSize - (start & (kScaleChunkSize - 1)));
+                        SampleConversion::dequantise(samples + start, dest, run, channelScales[channel][start / kScaleChunkSize]);
+
+                        start += run;
+                        dest += run;
+                        numSamples -= run;
+                    }
+                    break;
+                }
+
+                case RingFormat::Float32:
+                default:
+                    juce::FloatVectorOperations::copy(dest, static_cast<const float*>(channelData[channel]) + start, numSamples);
+                    break;
+            }
+        }
+
+        // Each chunk uses its own peak; earlier samples are requantised if a block raises it.
+        void encodeScaled(int channel, int start, const float* src, int numSamples)
+        {
+            auto* samples = static_cast<int16_t*>(channelData[channel]);
+            float* scales = channelScales[channel];
+
+            while (numSamples > 0)
+            {
+                const int offset = start & (kScaleChunkSize - 1);
+                const int chunkStart = start - offset;
+                const int run = juce::jmin(numSamples, kScaleChunkSize - offset);
+
+                const auto range = juce::FloatVectorOperations::findMinAndMax(src, run);
+                float scale = juce::jmax(-range.getStart(), range.getEnd()) / 32767.0f;
+                float& chunkScale = scales[chunkStart / kScaleChunkSize];
+
+                if (offset > 0)
+                {
+                    if (scale <= chunkScale)
+                        scale = chunkScale;
+                    else if (chunkScale > 0.0f)
+                        SampleConversion::rescale(samples + chunkStart, offset, chunkScale / scale);
+                }
+
+                chunkScale = scale;
+                SampleConversion::quantise(src, samples + start, run, scale);
+
+                start += run;
+                src += run;
+                numSamples -= run;
+            }
+        }
+
+        std::vector<float> ownedSamples_;
+        std::vector<float> ownedScales_;
+        RealtimeMemory::LockedRegion samplesLock_;
+        RealtimeMemory::LockedRegion scalesLock_;
+    };
+
+    // Where one written block landed, by host timeline and ring position.
+    struct BlockStamp
+    {
+        std::atomic<juce::int64> timelineStart{ kNoTimelinePosition };
+        std::atomic<uint64_t> ringStart{ 0 };
+        std::atomic<int> length{ 0 };
+    };
+
+    // Per-channel level statistics for one or more blocks.
+    struct BlockStats
+    {
+        int numChannels = 0;
+        int numSamples = 0;
+        std::array<float, kMaxChannels> sumSquares{};
+        std::array<float, kMaxChannels> peaks{};
+
+        void clear()
+        {
+            numChannels = 0;
+            numSamples = 0;
+            sumSquares.fill(0.0f);
+            peaks.fill(0.0f);
+        }
+
+        void merge(const BlockStats& other)
+        {
+            numChannels = juce::jmax(numChannels, other.numChannels);
+            numSamples += other.numSamples;
+
+            for (int ch = 0; ch < other.numChannels; ++ch)
+            {
+                sumSquares[static_cast<size_t>(ch)] += other.sumSquares[static_cast<size_t>(ch)];
+                peaks[static_cast<size_t>(ch)] = juce::jmax(peaks[static_cast<size_t>(ch)], other.peaks[static_cast<size_t>(ch)]);
+            }
+        }
+    };
+
+    // sequence is 2 * block + 1 while being written and 2 * block + 2 once complete.
+    struct SharedBlockStats
+    {
+        std::atomic<uint64_t> sequence{ 0 };
+        std::atomic<uint64_t> endPosition{ 0 };
+        std::atomic<int> numChannels{ 0 };
+        std::atomic<int> numSamples{ 0 };
+        std::array<std::atomic<float>, kMaxChannels> sumSquares{};
+        std::array<std::atomic<float>, kMaxChannels> peaks{};
+    };
+
+    // One registered After instance, on its own cache line. cursor is the ring position just
+    // past its last read; audioFrom is the write position when needsAudio was last raised.
+    struct alignas(kCacheLineSize) ReaderSlot
+    {
+        std::atomic<bool> inUse{ false };
+        std::atomic<bool> needsAudio{ false };
+        std::atomic<uint64_t> audioFrom{ 0 };
+        std::atomic<uint64_t> cursor{ 0 };
+        std::atomic<uint64_t> statsCursor{ 0 };
+
+        // Diagnostics, stored only by this slot's reader.
+        std::atomic<uint64_t> readerBlocks{ 0 };
+        std::atomic<uint64_t> readsBeforeWrite{ 0 };
+        std::atomic<uint64_t> audioReads{ 0 };
+        std::atomic<uint64_t> underruns{ 0 };
+        std::atomic<uint64_t> overruns{ 0 };
+        std::atomic<uint64_t> timelineMisses{ 0 };
+        std::atomic<uint64_t> lastWriterBlock{ 0 };
+        std::atomic<uint64_t> blockLag{ 0 };
+        std::atomic<uint64_t> maxBlockLag{ 0 };
+        std::atomic<juce::int64> samplesBehind{ 0 };
+        std::atomic<juce::int64> maxSamplesBehind{ 0 };
+
+        void resetDiagnostics(uint64_t writerBlocks)
+        {
+            for (auto* counter : { &readerBlocks, &readsBeforeWrite, &audioReads, &underruns, &overruns, &timelineMisses,
+                                   &blockLag, &maxBlockLag })
+                counter->store(0, std::memory_order_relaxed);
+
+            lastWriterBlock.store(writerBlocks, std::memory_order_relaxed);
+            samplesBehind.store(0, std::memory_order_relaxed);
+            maxSamplesBehind.store(0, std::memory_order_relaxed);
+        }
+    };
+
+    // One pair's scheduling counters as seen from one reader slot.
+    struct PairDiagnostics
+    {
+        bool valid = false;
+        uint64_t writerBlocks = 0;
+        uint64_t writePosition = 0;
+        uint64_t tornReads = 0;
+        uint64_t fallbackReads = 0;
+        uint64_t readerBlocks = 0;
+        uint64_t readsBeforeWrite = 0;
+        uint64_t audioReads = 0;
+        uint64_t underruns = 0;
+        uint64_t overruns = 0;
+        uint64_t timelineMisses = 0;
+        uint64_t blockLag = 0;
+        uint64_t maxBlockLag = 0;
+        juce::int64 samplesBehind = 0;
+        juce::int64 maxSamplesBehind = 0;
+    };
+
+    // Per-pair state shared by writer and readers: lock-free atomics only, so it can live in
+    // a shared segment, grouped one cache line per writing thread.
+    struct alignas(kCacheLineSize) PairControl
+    {
+        // Writer-owned.
+        alignas(kCacheLineSize) std::atomic<uint64_t> writePosition{ 0 };
+        // Seqlock counter: odd while a write is in progress, advanced by two per block.
         std::atomic<uint64_t> writeSequence{ 0 };
-        std::atomic<double> sampleRate{ 48000.0 };
-        std::atomic<int> numChannels{ 2 };
+        std::atomic<uint64_t> statsBlocksWritten{ 0 };
+        std::atomic<uint64_t> statsSamplesWritten{ 0 };
+        // Ring contents before this position predate a restart().
+        std::atomic<uint64_t> validFrom{ 0 };
         std::atomic<bool> beforeInstanceActive{ false };
-        std::atomic<uint64_t> lastWriteTime{ 0 };
 
-        int bufferSize = kDefaultBufferSize;
+        alignas(kCacheLineSize) std::atomic<double> sampleRate{ 0.0 };
+        // The writer skips the ring entirely unless a registered reader asks for raw audio.
+        std::atomic<int> registeredReaders{ 0 };
+
+        alignas(kCacheLineSize) std::atomic<uint64_t> tornReadCount{ 0 };
+        std::atomic<uint64_t> fallbackReadCount{ 0 };
+
+        // Writer-owned tables, slot = block & (count - 1).
+        alignas(kCacheLineSize) std::array<BlockStamp, kBlockStampCount> blockStamps;
+
+        std::array<SharedBlockStats, kStatsBlockCount> blockStats;
+
+        std::array<ReaderSlot, kMaxReaders> readers;
+
+        // Off the audio thread. Returns the claimed slot, or -1 if all kMaxReaders are taken.
+        int registerReader()
+        {
+            for (int slot = 0; slot < kMaxReaders; ++slot)
+            {
+                bool expected = false;
+                auto& reader = readers[static_cast<size_t>(slot)];
+
+                if (reader.inUse.compare_exchange_strong(expected, true))
+                {
+                    reader.needsAudio.store(false);
+                    reader.audioFrom.store(writePosition.load(std::memory_order_acquire));
+                    reader.cursor.store(writePosition.load(std::memory_order_acquire));
+                    reader.statsCursor.store(statsBlocksWritten.load(std::memory_order_acquire));
+                    reader.resetDiagnostics(statsBlocksWritten.load(std::memory_order_acquire));
+                    registeredReaders.fetch_add(1);
+                    return slot;
+                }
+            }
+
+            return -1;
+        }
+
+        void unregisterReader(int slot)
+        {
+            if (juce::isPositiveAndBelow(slot, kMaxReaders)
+                && readers[static_cast<size_t>(slot)].inUse.exchange(false))
+                registeredReaders.fetch_sub(1);
+        }
+
+        // Only samples written from now on can be read with audio.
+        void setReaderNeedsAudio(int slot, bool needsAudio)
+        {
+            if (! juce::isPositiveAndBelow(slot, kMaxReaders))
+                return;
+
+            auto& reader = readers[static_cast<size_t>(slot)];
+
+            if (needsAudio && ! reader.needsAudio.load(std::memory_order_relaxed))
+                reader.audioFrom.store(writePosition.load(std::memory_order_acquire), std::memory_order_relaxed);
+
+            reader.needsAudio.store(needsAudio, std::memory_order_release);
+        }
+
+        bool anyReaderNeedsAudio() const
+        {
+            for (const auto& reader : readers)
+                if (reader.inUse.load(std::memory_order_relaxed) && reader.needsAudio.load(std::memory_order_relaxed))
+                    return true;
+
+            return false;
+        }
+
+        // Readers judge liveness themselves with WriterLiveness.
+        bool isBeforeInstanceActive() const
+        {
+            return beforeInstanceActive.load(std::memory_order_acquire);
+        }
+    };
+
+    // The writer counts as alive while its block count keeps advancing within timeoutSamples
+    // of the reader's own audio, in realtime and offline alike.
+    class WriterLiveness
+    {
+    public:
+        void setTimeoutSamples(int samples)
+        {
+            timeoutSamples_ = juce::jmax(1, samples);
+        }
+
+        void reset()
+        {
+            lastBlockCount_ = 0;
+            samplesSinceProgress_ = std::numeric_limits<juce::int64>::max() / 2;
+        }
+
+        bool update(uint64_t writerBlocks, bool writerActive, int numSamples)
+        {
+            if (writerBlocks != lastBlockCount_)
+            {
+                lastBlockCount_ = writerBlocks;
+                samplesSinceProgress_ = 0;
+            }
+            else
+            {
+                samplesSinceProgress_ += numSamples;
+            }
+
+            return writerActive && samplesSinceProgress_ < timeoutSamples_;
+        }
+
+    private:
+        uint64_t lastBlockCount_ = 0;
+        juce::int64 samplesSinceProgress_ = std::numeric_limits<juce::int64>::max() / 2;
+        int timeoutSamples_ = 48000;
+    };
+
+    // The lock-free write/read protocol, shared by every transport backend.
+    namespace RingProtocol
+    {
+        enum class TimelineLookup
+        {
+            Found,
+            NotFound,
+            NotYetWritten,
+            Overwritten
+        };
+
+        // For single-writer counters: a relaxed load and store, no RMW.
+        inline void bump(std::atomic<uint64_t>& counter)
+        {
+            counter.store(counter.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        }
+
+        inline ReaderSlot* getReader(PairControl& control, int readerSlot)
+        {
+            return juce::isPositiveAndBelow(readerSlot, kMaxReaders) ? &control.readers[static_cast<size_t>(readerSlot)]
+                                                                     : nullptr;
+        }
+
+        inline void recordBlock(ReaderSlot& reader, uint64_t writerBlocks)
+        {
+            bump(reader.readerBlocks);
+
+            const uint64_t lag = writerBlocks - reader.lastWriterBlock.load(std::memory_order_relaxed);
+            reader.lastWriterBlock.store(writerBlocks, std::memory_order_relaxed);
+            reader.blockLag.store(lag, std::memory_order_relaxed);
+
+            if (lag == 0)
+                bump(reader.readsBeforeWrite);
+            else if (lag > reader.maxBlockLag.load(std::memory_order_relaxed))
+                reader.maxBlockLag.store(lag, std::memory_order_relaxed);
+        }
+
+        inline void recordRead(ReaderSlot& reader, uint64_t writePos, uint64_t readEnd)
+        {
+            bump(reader.audioReads);
+
+            const auto behind = static_cast<juce::int64>(writePos - readEnd);
+            reader.samplesBehind.store(behind, std::memory_order_relaxed);
+
+            if (behind > reader.maxSamplesBehind.load(std::memory_order_relaxed))
+                reader.maxSamplesBehind.store(behind, std::memory_order_relaxed);
+        }
+
+        inline PairDiagnostics getDiagnostics(const PairControl& control, int readerSlot)
+        {
+            PairDiagnostics diagnostics;
+            diagnostics.writerBlocks = control.statsBlocksWritten.load(std::memory_order_relaxed);
+            diagnostics.writePosition = control.writePosition.load(std::memory_order_relaxed);
+            diagnostics.tornReads = control.tornReadCount.load(std::memory_order_relaxed);
+            diagnostics.fallbackReads = control.fallbackReadCount.load(std::memory_order_relaxed);
+
+            if (! juce::isPositiveAndBelow(readerSlot, kMaxReaders))
+                return diagnostics;
+
+            const auto& reader = control.readers[static_cast<size_t>(readerSlot)];
+            diagnostics.valid = reader.inUse.load(std::memory_order_relaxed);
+            diagnostics.readerBlocks = reader.readerBlocks.load(std::memory_order_relaxed);
+            diagnostics.readsBeforeWrite = reader.readsBeforeWrite.load(std::memory_order_relaxed);
+            diagnostics.audioReads = reader.audioReads.load(std::memory_order_relaxed);
+            diagnostics.underruns = reader.underruns.load(std::memory_order_relaxed);
+            diagnostics.overruns = reader.overruns.load(std::memory_order_relaxed);
+            diagnostics.timelineMisses = reader.timelineMisses.load(std::memory_order_relaxed);
+            diagnostics.blockLag = reader.blockLag.load(std::memory_order_relaxed);
+            diagnostics.maxBlockLag = reader.maxBlockLag.load(std::memory_order_relaxed);
+            diagnostics.samplesBehind = reader.samplesBehind.load(std::memory_order_relaxed);
+            diagnostics.maxSamplesBehind = reader.maxSamplesBehind.load(std::memory_order_relaxed);
+            return diagnostics;
+        }
+
+        // Finds the ring position holding timeline sample target; fails if it isn't in the ring.
+        inline TimelineLookup findTimelinePosition(const PairControl& control, const RingStorage& ring, uint64_t sequence,
+                                                   uint64_t writePos, juce::int64 target, int numSamples, uint64_t& ringPos)
+        {
+            const uint64_t blocksWritten = sequence / 2;
+            const uint64_t blocksToSearch = juce::jmin(blocksWritten, static_cast<uint64_t>(kBlockStampCount));
+
+            for (uint64_t i = 0; i < blocksToSearch; ++i)
+            {
+                const auto& stamp = control.blockStamps[static_cast<size_t>((blocksWritten - 1 - i) & (kBlockStampCount - 1))];
+                const auto start = stamp.timelineStart.load(std::memory_order_relaxed);
+
+                if (start == kNoTimelinePosition || target < start)
+                    continue;
+
+                // Keep looking on a miss: after a loop jump an older block may still hold target.
+                if (target >= start + stamp.length.load(std::memory_order_relaxed))
+                    continue;
+
+                ringPos = stamp.ringStart.load(std::memory_order_relaxed) + static_cast<uint64_t>(target - start);
+
+                if (ringPos + static_cast<uint64_t>(numSamples) > writePos)
+                    return TimelineLookup::NotYetWritten;
+
+                if (ringPos + static_cast<uint64_t>(ring.bufferSize) < writePos)
+                    return TimelineLookup::Overwritten;
+
+                return TimelineLookup::Found;
+            }
+
+            return TimelineLookup::NotFound;
+        }
+
+        // By host timeline while it is still in the ring, otherwise latencyOffset behind the head.
+        inline uint64_t locateRead(const PairControl& control, const RingStorage& ring, uint64_t sequence, uint64_t writePos,
+                                   int numSamples, int latencyOffset, juce::int64 timelinePosition, TimelineLookup& lookup)
+        {
+            // Unsigned wrap-around is harmless: the capacity divides 2^64.
+            uint64_t readPos = writePos - static_cast<uint64_t>(numSamples) - static_cast<uint64_t>(latencyOffset);
+            lookup = TimelineLookup::Found;
+
+            if (timelinePosition != kNoTimelinePosition)
+            {
+                uint64_t timelineReadPos = 0;
+                lookup = findTimelinePosition(control, ring, sequence, writePos, timelinePosition - latencyOffset,
+                                              numSamples, timelineReadPos);
+                if (lookup == TimelineLookup::Found)
+                    readPos = timelineReadPos;
+            }
+
+            return readPos;
+        }
+
+        // Samples from before a restart() or before the reader raised needsAudio are stale.
+        inline bool predatesAudio(const PairControl& control, const ReaderSlot* reader, uint64_t readPos)
+        {
+            const auto startsBefore = [readPos](uint64_t from) { return static_cast<juce::int64>(readPos - from) < 0; };
+
+            return startsBefore(control.validFrom.load(std::memory_order_relaxed))
+                || (reader != nullptr && startsBefore(reader->audioFrom.load(std::memory_order_relaxed)));
+        }
+
+        inline bool isOverwritten(const RingStorage& ring, uint64_t writePos, uint64_t readPos)
+        {
+            return writePos - readPos > static_cast<uint64_t>(ring.bufferSize);
+        }
+
+        inline void recordContinuousRead(ReaderSlot& reader, TimelineLookup lookup, uint64_t writePos, uint64_t readPos,
+                                         int numSamples)
+        {
+            const auto gap = static_cast<juce::int64>(readPos - reader.cursor.load(std::memory_order_relaxed));
+            const bool continues = reader.audioReads.load(std::memory_order_relaxed) == 0 || gap == 0;
+
+            if (lookup == TimelineLookup::NotYetWritten || (! continues && gap < 0))
+                bump(reader.underruns);
+            else if (lookup == TimelineLookup::Overwritten || (! continues && gap > 0))
+                bump(reader.overruns);
+
+            if (lookup != TimelineLookup::Found)
+                bump(reader.timelineMisses);
+
+            const uint64_t readEnd = readPos + static_cast<uint64_t>(numSamples);
+            reader.cursor.store(readEnd, std::memory_order_relaxed);
+            recordRead(reader, writePos, readEnd);
+        }
+
+        inline void write(PairControl& control, RingStorage& ring, const juce::AudioBuffer<float>& source, int numSamples,
+                          juce::int64 timelinePosition = kNoTimelinePosition)
+        {
+            if (! control.anyReaderNeedsAudio())
+                return;
+
+            const int numChannels = juce::jmin(source.getNumChannels(), ring.numChannels);
+
+            const uint64_t writePos = control.writePosition.load(std::memory_order_relaxed);
+            const uint64_t sequence = control.writeSequence.load(std::memory_order_relaxed);
+
+            control.writeSequence.store(sequence + 1, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_release);
+
+            const int numToCopy = juce::jmin(numSamples, ring.bufferSize);
+            const int skip = numSamples - numToCopy;
+
+            for (int ch = 0; ch < numChannels; ++ch)
+                ring.copyToRing(ch, writePos + static_cast<uint64_t>(skip), source.getReadPointer(ch) + skip, numToCopy);
+
+            auto& stamp = control.blockStamps[static_cast<size_t>((sequence / 2) & (kBlockStampCount - 1))];
+            stamp.timelineStart.store(timelinePosition, std::memory_order_relaxed);
+            stamp.ringStart.store(writePos, std::memory_order_relaxed);
+            stamp.length.store(numSamples, std::memory_order_relaxed);
+
+            control.writePosition.store(writePos + static_cast<uint64_t>(numSamples), std::memory_order_release);
+            control.writeSequence.store(sequence + 2, std::memory_order_release);
+        }
+
+        // Runs change inside an empty write, so a reader overlapping it retries, and marks the
+        // ring stale. Writer only.
+        template <typename Change>
+        inline void restart(PairControl& control, Change&& change)
+        {
+            const uint64_t sequence = control.writeSequence.load(std::memory_order_relaxed);
+
+            control.writeSequence.store(sequence + 1, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_release);
+
+            change();
+
+            auto& stamp = control.blockStamps[static_cast<size_t>((sequence / 2) & (kBlockStampCount - 1))];
+            stamp.timelineStart.store(kNoTimelinePosition, std::memory_order_relaxed);
+            stamp.length.store(0, std::memory_order_relaxed);
+
+            control.validFrom.store(control.writePosition.load(std::memory_order_relaxed), std::memory_order_relaxed);
+            control.writeSequence.store(sequence + 2, std::memory_order_release);
+        }
+
+        // Called for every writer block, so it doubles as the writer's heartbeat.
+        inline void writeStats(PairControl& control, const BlockStats& stats)
+        {
+            if (! control.beforeInstanceActive.load(std::memory_order_relaxed))
+                control.beforeInstanceActive.store(true, std::memory_order_release);
+
+            if (control.registeredReaders.load(std::memory_order_relaxed) == 0)
+                return;
+
+            const uint64_t block = control.statsBlocksWritten.load(std::memory_order_relaxed);
+            const uint64_t endPosition = control.statsSamplesWritten.load(std::memory_order_relaxed)
+                                       + static_cast<uint64_t>(stats.numSamples);
+            auto& entry = control.blockStats[static_cast<size_t>(block & (kStatsBlockCount - 1))];
+
+            entry.sequence.store(2 * block + 1, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_release);
+
+            const int numChannels = juce::jmin(stats.numChannels, kMaxChannels);
+            entry.endPosition.store(endPosition, std::memory_order_relaxed);
+            entry.numChannels.store(numChannels, std::memory_order_relaxed);
+            entry.numSamples.store(stats.numSamples, std::memory_order_relaxed);
+
+            for (int ch = 0; ch < numChannels; ++ch)
+            {
+                entry.sumSquares[static_cast<size_t>(ch)].store(stats.sumSquares[static_cast<size_t>(ch)], std::memory_order_relaxed);
+                entry.peaks[static_cast<size_t>(ch)].store(stats.peaks[static_cast<size_t>(ch)], std::memory_order_relaxed);
+            }
+
+            entry.sequence.store(2 * block + 2, std::memory_order_release);
+            control.statsSamplesWritten.store(endPosition, std::memory_order_release);
+            control.statsBlocksWritten.store(block + 1, std::memory_order_release);
+        }
+
+        // Merges unconsumed stats blocks at least latencyOffset behind; false if there are none.
+        inline bool readStats(PairControl& control, int readerSlot, int latencyOffset, BlockStats& dest)
+        {
+            dest.clear();
+
+            if (! juce::isPositiveAndBelow(readerSlot, kMaxReaders))
+                return false;
+
+            auto& reader = control.readers[static_cast<size_t>(readerSlot)];
+            const uint64_t blocksWritten = control.statsBlocksWritten.load(std::memory_order_acquire);
+            const uint64_t samplesWritten = control.statsSamplesWritten.load(std::memory_order_acquire);
+            uint64_t next = reader.statsCursor.load(std::memory_order_relaxed);
+
+            recordBlock(reader, blocksWritten);
+
+            if (blocksWritten > static_cast<uint64_t>(kStatsBlockCount)
+                && next < blocksWritten - static_cast<uint64_t>(kStatsBlockCount))
+            {
+                next = blocksWritten - static_cast<uint64_t>(kStatsBlockCount);
+                bump(reader.overruns);
+            }
+
+            for (; next < blocksWritten; ++next)
+            {
+                const auto& entry = control.blockStats[static_cast<size_t>(next & (kStatsBlockCount - 1))];
+                const uint64_t expected = 2 * next + 2;
+
+                if (entry.sequence.load(std::memory_order_acquire) != expected)
+                    break;
+
+                if (entry.endPosition.load(std::memory_order_relaxed) + static_cast<uint64_t>(juce::jmax(0, latencyOffset)) > samplesWritten)
+                    break;
+
+                BlockStats block;
+                block.numChannels = juce::jlimit(0, kMaxChannels, entry.numChannels.load(std::memory_order_relaxed));
+                block.numSamples = entry.numSamples.load(std::memory_order_relaxed);
+
+                for (int ch = 0; ch < block.numChannels; ++ch)
+                {
+                    block.sumSquares[static_cast<size_t>(ch)] = entry.sumSquares[static_cast<size_t>(ch)].load(std::memory_order_relaxed);
+                    block.peaks[static_cast<size_t>(ch)] = entry.peaks[static_cast<size_t>(ch)].load(std::memory_order_relaxed);
+                }
+
+                std::atomic_thread_fence(std::memory_order_acquire);
+
+                // The writer lapped us mid-copy; the skip-ahead above recovers next time.
+                if (entry.sequence.load(std::memory_order_relaxed) != expected)
+                {
+                    control.tornReadCount.fetch_add(1, std::memory_order_relaxed);
+                    break;
+                }
+
+                dest.merge(block);
+            }
+
+            reader.statsCursor.store(next, std::memory_order_relaxed);
+            return dest.numSamples > 0;
+        }
+
+        // Copies from the absolute ring position pos, for readers that track their own.
+        inline bool readAt(PairControl& control, const RingStorage& ring, float* const* dest, int numChannels,
+                           uint64_t pos, int numSamples, int readerSlot = -1)
+        {
+            numChannels = juce::jmin(numChannels, ring.numChannels);
+            auto* reader = getReader(control, readerSlot);
+
+            for (int attempt = 0; attempt < kMaxReadAttempts; ++attempt)
+            {
+                const uint64_t sequenceBefore = control.writeSequence.load(std::memory_order_acquire);
+
+                if ((sequenceBefore & 1) == 0)
+                {
+                    const uint64_t writePos = control.writePosition.load(std::memory_order_acquire);
+                    const bool notYetWritten = pos + static_cast<uint64_t>(numSamples) > writePos
+                                            || predatesAudio(control, reader, pos);
+
+                    if (notYetWritten || pos + static_cast<uint64_t>(ring.bufferSize) < writePos)
+                    {
+                        if (reader != nullptr)
+                            bump(notYetWritten ? reader->underruns : reader->overruns);
+
+                        return false;
+                    }
+
+                    for (int ch = 0; ch < numChannels; ++ch)
+                        ring.copyFromRing(ch, dest[ch], pos, numSamples);
+
+                    std::atomic_thread_fence(std::memory_order_acquire);
+
+                    if (control.writeSequence.load(std::memory_order_relaxed) == sequenceBefore)
+                    {
+                        if (reader != nullptr)
+                            recordRead(*reader, writePos, pos + static_cast<uint64_t>(numSamples));
+
+                        return true;
+                    }
+                }
+
+                control.tornReadCount.fetch_add(1, std::memory_order_relaxed);
+            }
+
+            control.fallbackReadCount.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+
+        // False if every attempt was torn; dest may then hold a partial copy. Located by host
+        // timeline when given and still in the ring, otherwise relative to the write head.
+        inline bool read(PairControl& control, const RingStorage& ring, juce::AudioBuffer<float>& dest, int numSamples, int latencyOffset,
+                         juce::int64 timelinePosition = kNoTimelinePosition, int readerSlot = -1)
+        {
+            const int numChannels = juce::jmin(dest.getNumChannels(), ring.numChannels);
+            jassert(numSamples <= ring.bufferSize);
+            numSamples = juce::jmin(numSamples, ring.bufferSize);
+            auto* reader = getReader(control, readerSlot);
+
+            for (int attempt = 0; attempt < kMaxReadAttempts; ++attempt)
+            {
+                const uint64_t sequenceBefore = control.writeSequence.load(std::memory_order_acquire);
+
+                if ((sequenceBefore & 1) == 0)
+                {
+                    const uint64_t writePos = control.writePosition.load(std::memory_order_acquire);
+                    auto lookup = TimelineLookup::Found;
+                    const uint64_t readPos = locateRead(control, ring, sequenceBefore, writePos, numSamples, latencyOffset,
+                                                        timelinePosition, lookup);
+
+                    if (predatesAudio(control, reader, readPos))
+                    {
+                        if (reader != nullptr)
+                            bump(reader->underruns);
+
+                        return false;
+                    }
+
+                    if (isOverwritten(ring, writePos, readPos))
+                    {
+                        if (reader != nullptr)
+                            bump(reader->overruns);
+
+                        return false;
+                    }
+
+                    for (int ch = 0; ch < numChannels; ++ch)
+                        ring.copyFromRing(ch, dest.getWritePointer(ch), readPos, numSamples);
+
+                    std::atomic_thread_fence(std::memory_order_acquire);
+
+                    if (control.writeSequence.load(std::memory_order_relaxed) == sequenceBefore)
+                    {
+                        if (reader != nullptr)
+                            recordContinuousRead(*reader, lookup, writePos, readPos, numSamples);
 
-        SharedAudioData()
+                        return true;
+                    }
+                }
+
+                control.tornReadCount.fetch_add(1, std::memory_order_relaxed);
+            }
+
+            control.fallbackReadCount.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+
+        // A block in place in a Float32 ring: first[ch] for firstLength samples, then second[ch].
+        struct RingView
+        {
+            int numChannels = 0;
+            int numSamples = 0;
+            int firstLength = 0;
+            std::array<const float*, kMaxChannels> first{};
+            std::array<const float*, kMaxChannels> second{};
+
+            PairControl* control = nullptr;
+            void* owner = nullptr;
+            int readerSlot = -1;
+            uint64_t sequence = 0;
+            uint64_t writePosition = 0;
+            uint64_t readPosition = 0;
+            TimelineLookup lookup = TimelineLookup::Found;
+        };
+
+        // Zero-copy read(); fails rather than waits on a write, so callers fall back to read().
+        inline bool beginView(const PairControl& control, const RingStorage& ring, int numSamples, int latencyOffset,
+                              juce::int64 timelinePosition, int readerSlot, RingView& view)
         {
-            for (auto& ch : channelBuffers)
-                ch.resize(kDefaultBufferSize, 0.0f);
+            if (ring.format != RingFormat::Float32 || numSamples > ring.bufferSize)
+                return false;
+
+            const uint64_t sequence = control.writeSequence.load(std::memory_order_acquire);
+            if ((sequence & 1) != 0)
+                return false;
+
+            const uint64_t writePos = control.writePosition.load(std::memory_order_acquire);
+            view.readPosition = locateRead(control, ring, sequence, writePos, numSamples, latencyOffset, timelinePosition,
+                                           view.lookup);
+
+            const auto* reader = juce::isPositiveAndBelow(readerSlot, kMaxReaders)
+                                     ? &control.readers[static_cast<size_t>(readerSlot)] : nullptr;
+
+            if (predatesAudio(control, reader, view.readPosition) || isOverwritten(ring, writePos, view.readPosition))
+                return false;
+
+            const int start = static_cast<int>(view.readPosition & static_cast<uint64_t>(ring.bufferMask));
+            view.numChannels = ring.numChannels;
+            view.numSamples = numSamples;
+            view.firstLength = juce::jmin(numSamples, ring.bufferSize - start);
+
+            for (int ch = 0; ch < ring.numChannels; ++ch)
+            {
+                const auto* samples = static_cast<const float*>(ring.channelData[static_cast<size_t>(ch)]);
+                view.first[static_cast<size_t>(ch)] = samples + start;
+                view.second[static_cast<size_t>(ch)] = samples;
+            }
+
+            view.readerSlot = readerSlot;
+            view.sequence = sequence;
+            view.writePosition = writePos;
+            return true;
         }
 
-        void resize(int newSize, int channels)
+        // False if the writer published meanwhile, so the view may mix two blocks.
+        inline bool endView(PairControl& control, const RingView& view)
         {
-            bufferSize = newSize;
-            numChannels.store(channels);
-            for (int ch = 0; ch < channels && ch < kMaxChannels; ++ch)
-                channelBuffers[ch].resize(newSize, 0.0f);
+            std::atomic_thread_fence(std::memory_order_acquire);
+
+            if (control.writeSequence.load(std::memory_order_relaxed) != view.sequence)
+            {
+                control.tornReadCount.fetch_add(1, std::memory_order_relaxed);
+                return false;
+            }
+
+            if (auto* reader = getReader(control, view.readerSlot))
+                recordContinuousRead(*reader, view.lookup, view.writePosition, view.readPosition, view.numSamples);
+
+            return true;
         }
+    }
 
-        void clear()
+    enum class TransportType
+    {
+        InProcess = 0,
+        SharedMemory = 1
+    };
+
+    // prepareBuffer is called off the audio thread; everything else must be wait-free.
+    class PairTransport
+    {
+    public:
+        virtual ~PairTransport() = default;
+
+        virtual bool isAvailable() const { return true; }
+
+        virtual void acquirePair(int pairID) { juce::ignoreUnused(pairID); }
+        virtual void releasePair(int pairID) { juce::ignoreUnused(pairID); }
+
+        // Rings grow to minRingSamples but never shrink while the pair is alive.
+        virtual void prepareBuffer(int pairID, int numChannels, int minRingSamples) = 0;
+        // May be less than was asked for where a shared ring can't grow.
+        virtual int getRingCapacity(int pairID) const = 0;
+        virtual void setWriterSampleRate(int pairID, double sampleRate) = 0;
+        virtual double getWriterSampleRate(int pairID) const = 0;
+        virtual void setRingFormat(int pairID, RingFormat format) = 0;
+        virtual void writeSamples(int pairID, const juce::AudioBuffer<float>& source, int numSamples,
+                                  juce::int64 timelinePosition = kNoTimelinePosition) = 0;
+        virtual bool readSamples(int pairID, juce::AudioBuffer<float>& dest, int numSamples, int latencyOffset = 0,
+                                 juce::int64 timelinePosition = kNoTimelinePosition, int readerSlot = -1) = 0;
+        virtual uint64_t getWritePosition(int pairID) const = 0;
+        virtual bool readSamplesAt(int pairID, float* const* dest, int numChannels, uint64_t position, int numSamples,
+                                   int readerSlot = -1) = 0;
+        // A true return pins the ring until endView() on the same thread.
+        virtual bool beginView(int pairID, int numSamples, int latencyOffset, juce::int64 timelinePosition, int readerSlot,
+                               RingProtocol::RingView& view) = 0;
+        virtual bool endView(RingProtocol::RingView& view) = 0;
+
+        virtual void writeStats(int pairID, const BlockStats& stats) = 0;
+        virtual bool readStats(int pairID, int readerSlot, int latencyOffset, BlockStats& dest) = 0;
+        virtual void setReaderNeedsAudio(int pairID, int readerSlot, bool needsAudio) = 0;
+
+        // Returns -1 if the pair has no free reader slot.
+        virtual int registerReader(int pairID) = 0;
+        virtual void unregisterReader(int pairID, int readerSlot) = 0;
+        virtual bool isBeforeInstanceActive(int pairID) const = 0;
+        virtual uint64_t getWriterBlockCount(int pairID) const = 0;
+        virtual void setBeforeInstanceInactive(int pairID) = 0;
+        virtual uint64_t getTornReadCount(int pairID) const = 0;
+        virtual uint64_t getFallbackReadCount(int pairID) const = 0;
+        virtual PairDiagnostics getDiagnostics(int pairID, int readerSlot) const = 0;
+
+        virtual size_t getCommittedBytes() const = 0;
+    };
+
+    // Audio threads inside something the message thread may free, counted per side.
+    class AccessGuard
+    {
+    public:
+        enum class Side
+        {
+            Writer,
+            Reader
+        };
+
+        void enter(Side side) { countFor(side).fetch_add(1); }
+        void exit(Side side) { countFor(side).fetch_sub(1, std::memory_order_release); }
+
+        bool isIdle() const
+        {
+            return writers_.count.load() == 0 && readers_.count.load() == 0;
+        }
+
+    private:
+        struct alignas(kCacheLineSize) Count
+        {
+            std::atomic<int> count{ 0 };
+        };
+
+        std::atomic<int>& countFor(Side side) { return side == Side::Writer ? writers_.count : readers_.count; }
+
+        Count writers_;
+        Count readers_;
+    };
+
+    // Audio threads enter the guard before loading the pointer, so once the owner has
+    // unpublished the object and seen the guard idle, nothing still uses it.
+    template <typename Object>
+    class GuardedSlot
+    {
+    public:
+        class ScopedAccess
+        {
+        public:
+            ScopedAccess(GuardedSlot& slot, AccessGuard::Side side)
+                : slot_(slot), side_(side), object_(slot.enter(side))
+            {
+            }
+
+            ~ScopedAccess() { slot_.exit(side_); }
+
+            Object* get() const noexcept { return object_; }
+            Object& operator*() const noexcept { return *object_; }
+            Object* operator->() const noexcept { return object_; }
+            explicit operator bool() const noexcept { return object_ != nullptr; }
+
+        private:
+            GuardedSlot& slot_;
+            AccessGuard::Side side_;
+            Object* object_;
+
+            JUCE_DECLARE_NON_COPYABLE(ScopedAccess)
+        };
+
+        // For accesses that outlive a scope, such as views; every enter needs its exit.
+        Object* enter(AccessGuard::Side side)
+        {
+            guard_.enter(side);
+            return object_.load();
+        }
+
+        void exit(AccessGuard::Side side) { guard_.exit(side); }
+
+        void publish(Object* object) { object_.store(object); }
+        const AccessGuard& getGuard() const { return guard_; }
+
+    private:
+        std::atomic<Object*> object_{ nullptr };
+        AccessGuard guard_;
+    };
+
+    // A pair's control block plus its ring, which stays null until the first prepareBuffer.
+    struct SharedAudioData : PairControl
+    {
+        alignas(kCacheLineSize) std::atomic<RingStorage*> storage{ nullptr };
+
+        // Keeps the current ring if it is already big enough.
+        void reconfigure(int minSize, int channels)
+        {
+            std::lock_guard<std::mutex> lock(reconfigureMutex_);
+            replaceRingIfNeeded(minSize, channels, format_);
+        }
+
+        void setFormat(RingFormat format)
+        {
+            std::lock_guard<std::mutex> lock(reconfigureMutex_);
+            format_ = format;
+
+            if (current_ != nullptr)
+                replaceRingIfNeeded(current_->bufferSize, current_->numChannels, format);
+        }
+
+        // Returns false while a replaced ring couldn't be freed yet.
+        bool freeRetiredRings(const AccessGuard& guard)
+        {
+            std::lock_guard<std::mutex> lock(reconfigureMutex_);
+
+            if (! retired_.empty() && guard.isIdle())
+                retired_.clear();
+
+            return retired_.empty();
+        }
+
+    private:
+        void replaceRingIfNeeded(int minSize, int channels, RingFormat format)
         {
-            for (auto& ch : channelBuffers)
-                std::fill(ch.begin(), ch.end(), 0.0f);
-            writePosition.store(0);
-            writeSequence.store(0);
+            const auto* ring = current_.get();
+
+            if (ring != nullptr)
+            {
+                if (ring->bufferSize >= minSize && ring->numChannels >= juce::jmin(channels, kMaxChannels) && ring->format == format)
+                    return;
+
+                minSize = juce::jmax(minSize, ring->bufferSize);
+                channels = juce::jmax(channels, ring->numChannels);
+            }
+
+            auto replacement = std::make_unique<RingStorage>(minSize, channels, format);
+            storage.store(replacement.get());
+
+            if (current_ != nullptr)
+                retired_.push_back(std::move(current_));
+
+            current_ = std::move(replacement);
         }
+
+        std::mutex reconfigureMutex_;
+        RingFormat format_ = RingFormat::Float32;
+        std::unique_ptr<RingStorage> current_;
+        std::vector<std::unique_ptr<RingStorage>> retired_;
     };
 
-    class SharedBufferManager
+    // In-process transport: both instances must share one address space.
+    class SharedBufferManager : public PairTransport,
+                                private juce::Timer
     {
     public:
         static SharedBufferManager& getInstance()
@@ -58,115 +1145,363 @@ namespace GainStage
             return instance;
         }
 
-        SharedAudioData& getBuffer(int pairID)
+        void acquirePair(int pairID) override
         {
-            jassert(pairID >= 1 && pairID <= kMaxPairIDs);
-            return buffers_[pairID - 1];
+            if (pairID < 1 || pairID > kMaxPairIDs)
+                return;
+
+            std::lock_guard<std::mutex> lock(registryMutex_);
+            auto& slot = slots_[pairID - 1];
+
+            if (slot.data == nullptr)
+            {
+                slot.data = std::make_unique<SharedAudioData>();
+                pairs_[static_cast<size_t>(pairID)].publish(slot.data.get());
+            }
+
+            ++slot.references;
+            collectRetired();
         }
 
-        void writeSamples(int pairID, const juce::AudioBuffer<float>& source, int numSamples)
+        void releasePair(int pairID) override
         {
             if (pairID < 1 || pairID > kMaxPairIDs)
                 return;
 
-            auto& data = buffers_[pairID - 1];
-            const int numChannels = juce::jmin(source.getNumChannels(), kMaxChannels);
-            const int bufSize = data.bufferSize;
+            std::lock_guard<std::mutex> lock(registryMutex_);
+            auto& slot = slots_[pairID - 1];
+
+            if (slot.references > 0 && --slot.references == 0)
+            {
+                pairs_[static_cast<size_t>(pairID)].publish(nullptr);
 
-            int writePos = data.writePosition.load(std::memory_order_relaxed);
+                if (slot.name.isNotEmpty())
+                    pairIDsByName_.remove(slot.name);
 
-            for (int ch = 0; ch < numChannels; ++ch)
+                slot.name = {};
+                retired_.push_back({ std::move(slot.data), pairID });
+            }
+
+            if (! collectRetired())
+                startTimer(kReclaimIntervalMs);
+        }
+
+        // Returns the ID carrying this name or names the lowest unused one; 0 if none is free.
+        int assignPairName(const juce::String& name)
+        {
+            std::lock_guard<std::mutex> lock(registryMutex_);
+
+            if (pairIDsByName_.contains(name))
+                return pairIDsByName_[name];
+
+            for (int pairID = 1; pairID <= kMaxPairIDs; ++pairID)
             {
-                const float* src = source.getReadPointer(ch);
-                auto& dest = data.channelBuffers[ch];
+                auto& slot = slots_[pairID - 1];
 
-                int pos = writePos;
-                for (int i = 0; i < numSamples; ++i)
+                if (slot.references == 0 && slot.name.isEmpty())
                 {
-                    dest[pos] = src[i];
-                    pos = (pos + 1) % bufSize;
+                    slot.name = name;
+                    pairIDsByName_.set(name, pairID);
+                    return pairID;
                 }
             }
 
-            int newWritePos = (writePos + numSamples) % bufSize;
-            data.writePosition.store(newWritePos, std::memory_order_release);
-            data.writeSequence.fetch_add(1, std::memory_order_release);
-            data.lastWriteTime.store(juce::Time::currentTimeMillis(), std::memory_order_release);
-            data.beforeInstanceActive.store(true, std::memory_order_release);
+            return 0;
         }
 
-        void readSamples(int pairID, juce::AudioBuffer<float>& dest, int numSamples, int latencyOffset = 0)
+        int findPairID(const juce::String& name) const
         {
-            if (pairID < 1 || pairID > kMaxPairIDs)
-                return;
+            std::lock_guard<std::mutex> lock(registryMutex_);
+            return pairIDsByName_.contains(name) ? pairIDsByName_[name] : 0;
+        }
 
-            auto& data = buffers_[pairID - 1];
-            const int numChannels = juce::jmin(dest.getNumChannels(), data.numChannels.load());
-            const int bufSize = data.bufferSize;
+        void writeSamples(int pairID, const juce::AudioBuffer<float>& source, int numSamples,
+                          juce::int64 timelinePosition = kNoTimelinePosition) override
+        {
+            if (auto data = access(pairID, AccessGuard::Side::Writer))
+                if (auto* ring = data->storage.load())
+                    RingProtocol::write(*data, *ring, source, numSamples, timelinePosition);
+        }
+
+        bool readSamples(int pairID, juce::AudioBuffer<float>& dest, int numSamples, int latencyOffset = 0,
+                         juce::int64 timelinePosition = kNoTimelinePosition, int readerSlot = -1) override
+        {
+            if (auto data = access(pairID, AccessGuard::Side::Reader))
+                if (auto* ring = data->storage.load())
+                    return RingProtocol::read(*data, *ring, dest, numSamples, latencyOffset, timelinePosition, readerSlot);
 
-            int writePos = data.writePosition.load(std::memory_order_acquire);
+            return false;
+        }
 
-            int readPos = writePos - numSamples - latencyOffset;
-            while (readPos < 0)
-                readPos += bufSize;
-            readPos = readPos % bufSize;
+        uint64_t getWritePosition(int pairID) const override
+        {
+            if (auto data = access(pairID, AccessGuard::Side::Reader))
+                return data->writePosition.load(std::memory_order_acquire);
 
-            for (int ch = 0; ch < numChannels; ++ch)
-            {
-                float* destPtr = dest.getWritePointer(ch);
-                const auto& src = data.channelBuffers[ch];
+            return 0;
+        }
 
-                int pos = readPos;
-                for (int i = 0; i < numSamples; ++i)
-                {
-                    destPtr[i] = src[pos];
-                    pos = (pos + 1) % bufSize;
-                }
-            }
+        bool readSamplesAt(int pairID, float* const* dest, int numChannels, uint64_t position, int numSamples,
+                           int readerSlot = -1) override
+        {
+            if (auto data = access(pairID, AccessGuard::Side::Reader))
+                if (auto* ring = data->storage.load())
+                    return RingProtocol::readAt(*data, *ring, dest, numChannels, position, numSamples, readerSlot);
+
+            return false;
         }
 
-        bool isBeforeInstanceActive(int pairID) const
+        bool beginView(int pairID, int numSamples, int latencyOffset, juce::int64 timelinePosition, int readerSlot,
+                       RingProtocol::RingView& view) override
         {
             if (pairID < 1 || pairID > kMaxPairIDs)
                 return false;
 
-            const auto& data = buffers_[pairID - 1];
+            // Stays entered until endView().
+            auto& slot = pairs_[static_cast<size_t>(pairID)];
+            auto* data = slot.enter(AccessGuard::Side::Reader);
+            auto* ring = data != nullptr ? data->storage.load() : nullptr;
+
+            if (ring != nullptr && RingProtocol::beginView(*data, *ring, numSamples, latencyOffset, timelinePosition, readerSlot, view))
+            {
+                view.control = data;
+                view.owner = &slot;
+                return true;
+            }
+
+            slot.exit(AccessGuard::Side::Reader);
+            return false;
+        }
 
-            if (!data.beforeInstanceActive.load(std::memory_order_acquire))
+        bool endView(RingProtocol::RingView& view) override
+        {
+            auto* slot = static_cast<GuardedSlot<SharedAudioData>*>(view.owner);
+            if (slot == nullptr)
                 return false;
 
-            uint64_t lastWrite = data.lastWriteTime.load(std::memory_order_acquire);
-            uint64_t now = juce::Time::currentTimeMillis();
+            const bool intact = RingProtocol::endView(*view.control, view);
+            slot->exit(AccessGuard::Side::Reader);
+            view.control = nullptr;
+            view.owner = nullptr;
+            return intact;
+        }
+
+        void writeStats(int pairID, const BlockStats& stats) override
+        {
+            if (auto data = access(pairID, AccessGuard::Side::Writer))
+                RingProtocol::writeStats(*data, stats);
+        }
+
+        bool readStats(int pairID, int readerSlot, int latencyOffset, BlockStats& dest) override
+        {
+            if (auto data = access(pairID, AccessGuard::Side::Reader))
+                return RingProtocol::readStats(*data, readerSlot, latencyOffset, dest);
+
+            dest.clear();
+            return false;
+        }
+
+        void setReaderNeedsAudio(int pairID, int readerSlot, bool needsAudio) override
+        {
+            if (auto data = access(pairID, AccessGuard::Side::Reader))
+                data->setReaderNeedsAudio(readerSlot, needsAudio);
+        }
+
+        int registerReader(int pairID) override
+        {
+            if (auto data = access(pairID, AccessGuard::Side::Reader))
+                return data->registerReader();
+
+            return -1;
+        }
+
+        void unregisterReader(int pairID, int readerSlot) override
+        {
+            if (auto data = access(pairID, AccessGuard::Side::Reader))
+                data->unregisterReader(readerSlot);
+        }
+
+        uint64_t getTornReadCount(int pairID) const override
+        {
+            if (auto data = access(pairID, AccessGuard::Side::Reader))
+                return data->tornReadCount.load(std::memory_order_relaxed);
+
+            return 0;
+        }
+
+        uint64_t getFallbackReadCount(int pairID) const override
+        {
+            if (auto data = access(pairID, AccessGuard::Side::Reader))
+                return data->fallbackReadCount.load(std::memory_order_relaxed);
+
+            return 0;
+        }
+
+        PairDiagnostics getDiagnostics(int pairID, int readerSlot) const override
+        {
+            if (auto data = access(pairID, AccessGuard::Side::Reader))
+                return RingProtocol::getDiagnostics(*data, readerSlot);
+
+            return {};
+        }
+
+        bool isBeforeInstanceActive(int pairID) const override
+        {
+            if (auto data = access(pairID, AccessGuard::Side::Reader))
+                return data->isBeforeInstanceActive();
+
+            return false;
+        }
+
+        uint64_t getWriterBlockCount(int pairID) const override
+        {
+            if (auto data = access(pairID, AccessGuard::Side::Reader))
+                return data->statsBlocksWritten.load(std::memory_order_acquire);
+
+            return 0;
+        }
 
-            return (now - lastWrite) < 1000;
+        void setBeforeInstanceInactive(int pairID) override
+        {
+            if (auto data = access(pairID, AccessGuard::Side::Writer))
+                data->beforeInstanceActive.store(false, std::memory_order_release);
         }
 
-        void setBeforeInstanceInactive(int pairID)
+        void setRingFormat(int pairID, RingFormat format) override
         {
-            if (pairID >= 1 && pairID <= kMaxPairIDs)
-                buffers_[pairID - 1].beforeInstanceActive.store(false, std::memory_order_release);
+            if (pairID < 1 || pairID > kMaxPairIDs)
+                return;
+
+            std::lock_guard<std::mutex> lock(registryMutex_);
+
+            if (auto* data = slots_[pairID - 1].data.get())
+            {
+                data->setFormat(format);
+
+                if (! data->freeRetiredRings(pairs_[static_cast<size_t>(pairID)].getGuard()))
+                    startTimer(kReclaimIntervalMs);
+            }
         }
 
-        void prepareBuffer(int pairID, double sampleRate, int numChannels)
+        void prepareBuffer(int pairID, int numChannels, int minRingSamples) override
         {
             if (pairID < 1 || pairID > kMaxPairIDs)
                 return;
 
-            auto& data = buffers_[pairID - 1];
-            int newSize = static_cast<int>(sampleRate * kBufferLengthSeconds);
-            data.resize(newSize, numChannels);
-            data.sampleRate.store(sampleRate);
-            data.clear();
+            std::lock_guard<std::mutex> lock(registryMutex_);
+
+            if (auto* data = slots_[pairID - 1].data.get())
+            {
+                data->reconfigure(minRingSamples, numChannels);
+
+                if (! data->freeRetiredRings(pairs_[static_cast<size_t>(pairID)].getGuard()))
+                    startTimer(kReclaimIntervalMs);
+            }
+        }
+
+        int getRingCapacity(int pairID) const override
+        {
+            if (auto data = access(pairID, AccessGuard::Side::Reader))
+                if (auto* ring = data->storage.load())
+                    return ring->bufferSize;
+
+            return 0;
+        }
+
+        void setWriterSampleRate(int pairID, double sampleRate) override
+        {
+            if (auto data = access(pairID, AccessGuard::Side::Writer))
+                data->sampleRate.store(sampleRate, std::memory_order_release);
+        }
+
+        double getWriterSampleRate(int pairID) const override
+        {
+            if (auto data = access(pairID, AccessGuard::Side::Reader))
+                return data->sampleRate.load(std::memory_order_acquire);
+
+            return 0.0;
+        }
+
+        size_t getCommittedBytes() const override
+        {
+            std::lock_guard<std::mutex> lock(registryMutex_);
+
+            size_t numPairs = retired_.size();
+            for (const auto& slot : slots_)
+                if (slot.data != nullptr)
+                    ++numPairs;
+
+            return numPairs * sizeof(SharedAudioData) + RingStorage::getTotalOwnedBytes().load();
         }
 
     private:
+        static constexpr int kReclaimIntervalMs = 100;
+        static constexpr int kNoPair = 0;
+
+        using PairAccess = GuardedSlot<SharedAudioData>::ScopedAccess;
+
+        struct PairSlot
+        {
+            std::unique_ptr<SharedAudioData> data;
+            int references = 0;
+            juce::String name;
+        };
+
+        struct RetiredPair
+        {
+            std::unique_ptr<SharedAudioData> data;
+            int pairID = 0;
+        };
+
         SharedBufferManager() = default;
-        ~SharedBufferManager() = default;
+
+        ~SharedBufferManager() override
+        {
+            stopTimer();
+        }
 
         SharedBufferManager(const SharedBufferManager&) = delete;
         SharedBufferManager& operator=(const SharedBufferManager&) = delete;
 
-        std::array<SharedAudioData, kMaxPairIDs> buffers_;
+        // Every audio-thread access goes through the pair's guard.
+        PairAccess access(int pairID, AccessGuard::Side side) const
+        {
+            return { pairs_[static_cast<size_t>(juce::isPositiveAndNotGreaterThan(pairID, kMaxPairIDs) ? pairID : kNoPair)], side };
+        }
+
+        bool collectRetired()
+        {
+            retired_.erase(std::remove_if(retired_.begin(), retired_.end(),
+                                          [this](const RetiredPair& pair)
+                                          {
+                                              return pairs_[static_cast<size_t>(pair.pairID)].getGuard().isIdle();
+                                          }),
+                           retired_.end());
+
+            return retired_.empty();
+        }
+
+        void timerCallback() override
+        {
+            std::lock_guard<std::mutex> lock(registryMutex_);
+            bool pending = ! collectRetired();
+
+            for (int pairID = 1; pairID <= kMaxPairIDs; ++pairID)
+                if (auto* data = slots_[pairID - 1].data.get())
+                    if (! data->freeRetiredRings(pairs_[static_cast<size_t>(pairID)].getGuard()))
+                        pending = true;
+
+            if (! pending)
+                stopTimer();
+        }
+
+        // Indexed by pair ID; entry kNoPair never holds a pair, so invalid IDs resolve to it.
+        mutable std::array<GuardedSlot<SharedAudioData>, kMaxPairIDs + 1> pairs_;
+
+        mutable std::mutex registryMutex_;
+        std::array<PairSlot, kMaxPairIDs> slots_;
+        juce::HashMap<juce::String, int> pairIDsByName_;
+        std::vector<RetiredPair> retired_;
     };
 
 }
@@ -0,0 +1,841 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include <optional>
+#include "SharedBuffer.h"
+
+#if JUCE_LINUX || JUCE_MAC || JUCE_BSD
+ #include <cerrno>
+ #include <fcntl.h>
+ #include <signal.h>
+ #include <sys/mman.h>
+ #include <sys/stat.h>
+ #include <unistd.h>
+ #define GAINSTAGE_HAS_POSIX_SHM 1
+#else
+ #define GAINSTAGE_HAS_POSIX_SHM 0
+#endif
+
+namespace GainStage
+{
+    // A segment's ring is sized by the process that creates it, from its request, and is never
+    // under 2^18 samples (over a second at 192 kHz), so the partner's request usually fits too.
+    // A ring mapped by several processes can't be swapped out the way in-process rings are, so
+    // anything bigger asked of a shared segment is clamped and shows in getRingCapacity().
+    // Pages are only committed once touched, so a stereo pair doesn't pay for the 14 channels
+    // it never writes.
+    constexpr int kMinSharedMemoryRingSize = 262144;
+    constexpr int kMaxSharedMemoryRingSize = 2097152;
+
+    // Layout of one pair's segment: this header, then kMaxChannels planar rings sized for
+    // float samples, then the ScaledInt16 chunk scales. Narrower formats pack their channels
+    // into the first half of the sample area, so they only commit half the memory.
+    struct SharedMemoryHeader
+    {
+        // Bumped whenever the layout changes so mismatched builds refuse to share a segment.
+        static constexpr uint32_t kMagic = 0x55475339; // "UGS9"
+        static constexpr int kMaxProcesses = 32;
+
+        std::atomic<uint32_t> magic{ 0 };
+        // Samples per channel, fixed by the process that creates the segment.
+        std::atomic<int32_t> ringSize{ 0 };
+        // Format of the samples in the ring. Only the writer's audio thread changes it, inside
+        // RingProtocol::restart, once it sees a new requestedFormat.
+        std::atomic<int32_t> ringFormat{ 0 };
+        // Set from the process hosting the pair's Before instance; readers never touch it.
+        std::atomic<int32_t> requestedFormat{ 0 };
+        // Pid of the process attaching or detaching, 0 when free. A dead holder is replaced.
+        std::atomic<int32_t> lockOwner{ 0 };
+        // Set when the last process removed the name, so anyone still opening it starts over.
+        std::atomic<bool> unlinked{ false };
+        // Pids of the attached processes and of the process holding each reader slot, 0 when
+        // free, so whatever a crashed process held can be reclaimed.
+        std::array<std::atomic<int32_t>, kMaxProcesses> processes{};
+        std::array<std::atomic<int32_t>, kMaxReaders> readerProcesses{};
+        PairControl control;
+    };
+
+    static_assert(std::atomic<uint64_t>::is_always_lock_free, "Shared-memory pairs need address-free 64-bit atomics");
+    static_assert(std::atomic<double>::is_always_lock_free, "Shared-memory pairs need address-free double atomics");
+    static_assert(std::atomic<float>::is_always_lock_free, "Shared-memory pairs need address-free float atomics");
+
+    // Cross-process transport: each pair is a POSIX shared-memory segment that both plugin
+    // processes map, so the audio threads run the same RingProtocol directly on shared pages.
+    // Mapping happens in prepareBuffer; the audio thread only ever sees a fully mapped segment,
+    // and reaches it through the pair's GuardedSlot so the last release can unmap it.
+    class SharedMemoryTransport : public PairTransport,
+                                  private juce::Timer
+    {
+    public:
+        static SharedMemoryTransport& getInstance()
+        {
+            static SharedMemoryTransport instance;
+            return instance;
+        }
+
+        bool isAvailable() const override
+        {
+            return GAINSTAGE_HAS_POSIX_SHM != 0;
+        }
+
+        void acquirePair(int pairID) override
+        {
+            if (pairID < 1 || pairID > kMaxPairIDs)
+                return;
+
+            std::lock_guard<std::mutex> lock(mapMutex_);
+            ++slots_[pairID - 1].references;
+        }
+
+        // The last reference in this process unpublishes the mapping. It is unlocked,
+        // unmapped and detached (removing the segment if no other process uses it) once no
+        // audio thread is inside it.
+        void releasePair(int pairID) override
+        {
+            if (pairID < 1 || pairID > kMaxPairIDs)
+                return;
+
+            std::lock_guard<std::mutex> lock(mapMutex_);
+            auto& slot = slots_[pairID - 1];
+
+            if (slot.references > 0 && --slot.references == 0)
+            {
+                mappings_[static_cast<size_t>(pairID)].publish(nullptr);
+                slot.writerFormat.reset();
+
+                if (slot.mapping != nullptr)
+                    retired_.push_back({ std::move(slot.mapping), pairID });
+            }
+
+            if (! collectRetired())
+                startTimer(kReclaimIntervalMs);
+        }
+
+        // Maps the pair's segment, creating it sized for minRingSamples if no process has it
+        // yet. A segment that already exists keeps its size; a bigger request is clamped and
+        // reported by getRingCapacity().
+        void prepareBuffer(int pairID, int numChannels, int minRingSamples) override
+        {
+            if (pairID < 1 || pairID > kMaxPairIDs)
+                return;
+
+            std::lock_guard<std::mutex> lock(mapMutex_);
+            auto& slot = slots_[pairID - 1];
+
+            if (slot.references == 0)
+                return;
+
+            if (slot.mapping == nullptr)
+            {
+                slot.mapping = openSegment(pairID, minRingSamples);
+                mappings_[static_cast<size_t>(pairID)].publish(slot.mapping.get());
+            }
+
+            if (auto* mapping = slot.mapping.get())
+            {
+                if (slot.writerFormat)
+                    mapping->header->requestedFormat.store(static_cast<int32_t>(*slot.writerFormat), std::memory_order_relaxed);
+
+                mapping->lockChannels(numChannels);
+            }
+        }
+
+        int getRingCapacity(int pairID) const override
+        {
+            if (auto mapping = access(pairID, AccessGuard::Side::Reader))
+                return mapping->ringSize;
+
+            return 0;
+        }
+
+        void setWriterSampleRate(int pairID, double sampleRate) override
+        {
+            if (auto mapping = access(pairID, AccessGuard::Side::Writer))
+                mapping->header->control.sampleRate.store(sampleRate, std::memory_order_release);
+        }
+
+        double getWriterSampleRate(int pairID) const override
+        {
+            if (auto mapping = access(pairID, AccessGuard::Side::Reader))
+                return mapping->header->control.sampleRate.load(std::memory_order_acquire);
+
+            return 0.0;
+        }
+
+        // Only called for the pair's writer. The request goes into the segment and the
+        // writer's audio thread switches the ring over on its next block; readers in every
+        // process follow the segment's format.
+        void setRingFormat(int pairID, RingFormat format) override
+        {
+            if (pairID < 1 || pairID > kMaxPairIDs)
+                return;
+
+            std::lock_guard<std::mutex> lock(mapMutex_);
+            auto& slot = slots_[pairID - 1];
+            slot.writerFormat = format;
+
+            if (auto* mapping = slot.mapping.get())
+                mapping->header->requestedFormat.store(static_cast<int32_t>(format), std::memory_order_relaxed);
+        }
+
+        void writeSamples(int pairID, const juce::AudioBuffer<float>& source, int numSamples,
+                          juce::int64 timelinePosition = kNoTimelinePosition) override
+        {
+            auto mapping = access(pairID, AccessGuard::Side::Writer);
+            if (! mapping)
+                return;
+
+            auto& header = *mapping->header;
+            const auto requested = header.requestedFormat.load(std::memory_order_relaxed);
+
+            if (requested != header.ringFormat.load(std::memory_order_relaxed))
+            {
+                RingProtocol::restart(header.control, [&]
+                {
+                    header.ringFormat.store(requested, std::memory_order_relaxed);
+                    mapping->getRing(mapping->getFormat()).resetChunkScales(header.control.writePosition.load(std::memory_order_relaxed));
+                });
+            }
+
+            RingProtocol::write(header.control, mapping->getRing(mapping->getFormat()), source, numSamples, timelinePosition);
+        }
+
+        // Reads decode with the format the ring had when they started. A switch made after
+        // that is caught by checking the format again: the writer changes it inside the
+        // seqlock and marks the old contents stale, so a read that still sees the old format
+        // afterwards only ever used samples written in it.
+        bool readSamples(int pairID, juce::AudioBuffer<float>& dest, int numSamples, int latencyOffset = 0,
+                         juce::int64 timelinePosition = kNoTimelinePosition, int readerSlot = -1) override
+        {
+            if (auto mapping = access(pairID, AccessGuard::Side::Reader))
+            {
+                const auto format = mapping->getFormat();
+
+                return RingProtocol::read(mapping->header->control, mapping->getRing(format), dest, numSamples, latencyOffset,
+                                          timelinePosition, readerSlot)
+                    && mapping->getFormat() == format;
+            }
+
+            return false;
+        }
+
+        uint64_t getWritePosition(int pairID) const override
+        {
+            if (auto mapping = access(pairID, AccessGuard::Side::Reader))
+                return mapping->header->control.writePosition.load(std::memory_order_acquire);
+
+            return 0;
+        }
+
+        bool readSamplesAt(int pairID, float* const* dest, int numChannels, uint64_t position, int numSamples,
+                           int readerSlot = -1) override
+        {
+            if (auto mapping = access(pairID, AccessGuard::Side::Reader))
+            {
+                const auto format = mapping->getFormat();
+
+                return RingProtocol::readAt(mapping->header->control, mapping->getRing(format), dest, numChannels, position,
+                                            numSamples, readerSlot)
+                    && mapping->getFormat() == format;
+            }
+
+            return false;
+        }
+
+        bool beginView(int pairID, int numSamples, int latencyOffset, juce::int64 timelinePosition, int readerSlot,
+                       RingProtocol::RingView& view) override
+        {
+            if (pairID < 1 || pairID > kMaxPairIDs)
+                return false;
+
+            // Stays entered until endView() so the segment can't be unmapped under the view.
+            auto& slot = mappings_[static_cast<size_t>(pairID)];
+            auto* mapping = slot.enter(AccessGuard::Side::Reader);
+
+            if (mapping != nullptr)
+            {
+                const auto format = mapping->getFormat();
+
+                if (RingProtocol::beginView(mapping->header->control, mapping->getRing(format), numSamples, latencyOffset,
+                                            timelinePosition, readerSlot, view)
+                    && mapping->getFormat() == format)
+                {
+                    view.control = &mapping->header->control;
+                    view.owner = &slot;
+                    return true;
+                }
+            }
+
+            slot.exit(AccessGuard::Side::Reader);
+            return false;
+        }
+
+        bool endView(RingProtocol::RingView& view) override
+        {
+            auto* slot = static_cast<GuardedSlot<Mapping>*>(view.owner);
+            if (slot == nullptr)
+                return false;
+
+            const bool intact = RingProtocol::endView(*view.control, view);
+            slot->exit(AccessGuard::Side::Reader);
+            view.control = nullptr;
+            view.owner = nullptr;
+            return intact;
+        }
+
+        void writeStats(int pairID, const BlockStats& stats) override
+        {
+            if (auto mapping = access(pairID, AccessGuard::Side::Writer))
+                RingProtocol::writeStats(mapping->header->control, stats);
+        }
+
+        bool readStats(int pairID, int readerSlot, int latencyOffset, BlockStats& dest) override
+        {
+            if (auto mapping = access(pairID, AccessGuard::Side::Reader))
+                return RingProtocol::readStats(mapping->header->control, readerSlot, latencyOffset, dest);
+
+            return false;
+        }
+
+        void setReaderNeedsAudio(int pairID, int readerSlot, bool needsAudio) override
+        {
+            if (auto mapping = access(pairID, AccessGuard::Side::Reader))
+                mapping->header->control.setReaderNeedsAudio(readerSlot, needsAudio);
+        }
+
+        // Slots left behind by crashed reader processes are reclaimed when the pair is full.
+        int registerReader(int pairID) override
+        {
+            auto mapping = access(pairID, AccessGuard::Side::Reader);
+            if (! mapping)
+                return -1;
+
+            auto& header = *mapping->header;
+            int slot = header.control.registerReader();
+
+           #if GAINSTAGE_HAS_POSIX_SHM
+            if (slot < 0 && lockHeader(header))
+            {
+                reapDeadProcesses(header);
+                unlockHeader(header);
+                slot = header.control.registerReader();
+            }
+
+            if (slot >= 0)
+                header.readerProcesses[static_cast<size_t>(slot)].store(static_cast<int32_t>(getpid()));
+           #endif
+
+            return slot;
+        }
+
+        void unregisterReader(int pairID, int readerSlot) override
+        {
+            auto mapping = access(pairID, AccessGuard::Side::Reader);
+            if (! mapping || ! juce::isPositiveAndBelow(readerSlot, kMaxReaders))
+                return;
+
+           #if GAINSTAGE_HAS_POSIX_SHM
+            auto self = static_cast<int32_t>(getpid());
+            mapping->header->readerProcesses[static_cast<size_t>(readerSlot)].compare_exchange_strong(self, 0);
+           #endif
+
+            mapping->header->control.unregisterReader(readerSlot);
+        }
+
+        bool isBeforeInstanceActive(int pairID) const override
+        {
+            if (auto mapping = access(pairID, AccessGuard::Side::Reader))
+                return mapping->header->control.isBeforeInstanceActive();
+
+            return false;
+        }
+
+        uint64_t getWriterBlockCount(int pairID) const override
+        {
+            if (auto mapping = access(pairID, AccessGuard::Side::Reader))
+                return mapping->header->control.statsBlocksWritten.load(std::memory_order_acquire);
+
+            return 0;
+        }
+
+        void setBeforeInstanceInactive(int pairID) override
+        {
+            if (auto mapping = access(pairID, AccessGuard::Side::Writer))
+                mapping->header->control.beforeInstanceActive.store(false, std::memory_order_release);
+        }
+
+        uint64_t getTornReadCount(int pairID) const override
+        {
+            if (auto mapping = access(pairID, AccessGuard::Side::Reader))
+                return mapping->header->control.tornReadCount.load(std::memory_order_relaxed);
+
+            return 0;
+        }
+
+        uint64_t getFallbackReadCount(int pairID) const override
+        {
+            if (auto mapping = access(pairID, AccessGuard::Side::Reader))
+                return mapping->header->control.fallbackReadCount.load(std::memory_order_relaxed);
+
+            return 0;
+        }
+
+        PairDiagnostics getDiagnostics(int pairID, int readerSlot) const override
+        {
+            if (auto mapping = access(pairID, AccessGuard::Side::Reader))
+                return RingProtocol::getDiagnostics(mapping->header->control, readerSlot);
+
+            return {};
+        }
+
+        // Mapped size of every segment this process has attached to, including those waiting
+        // to be unmapped. Pages are committed as they are first touched, so this is an upper
+        // bound on what the segments really use.
+        size_t getCommittedBytes() const override
+        {
+            std::lock_guard<std::mutex> lock(mapMutex_);
+
+            size_t numBytes = 0;
+            for (const auto& slot : slots_)
+                if (slot.mapping != nullptr)
+                    numBytes += slot.mapping->size;
+
+            for (const auto& retired : retired_)
+                numBytes += retired.mapping->size;
+
+            return numBytes;
+        }
+
+        // Live processes attached to the pair's segment, this one included. Entries left by
+        // processes that died are freed on the way. Message thread only.
+        int getAttachedProcessCount(int pairID) const
+        {
+            int numAlive = 0;
+
+           #if GAINSTAGE_HAS_POSIX_SHM
+            if (auto mapping = access(pairID, AccessGuard::Side::Reader))
+            {
+                if (lockHeader(*mapping->header))
+                {
+                    numAlive = reapDeadProcesses(*mapping->header);
+                    unlockHeader(*mapping->header);
+                }
+            }
+           #else
+            juce::ignoreUnused(pairID);
+           #endif
+
+            return numAlive;
+        }
+
+        static juce::String getSegmentName(int pairID)
+        {
+            return "/UGainStage-pair-" + juce::String(pairID);
+        }
+
+    private:
+        static constexpr int kReclaimIntervalMs = 100;
+        static constexpr int kNoPair = 0;
+        static constexpr size_t kSamplesOffset = (sizeof(SharedMemoryHeader) + 63) & ~static_cast<size_t>(63);
+
+        static size_t getScalesOffset(int ringSize)
+        {
+            return kSamplesOffset + sizeof(float) * static_cast<size_t>(ringSize) * kMaxChannels;
+        }
+
+        static size_t getSegmentSize(int ringSize)
+        {
+            return getScalesOffset(ringSize) + sizeof(float) * static_cast<size_t>(ringSize / kScaleChunkSize) * kMaxChannels;
+        }
+
+        static int getRingSizeFor(int minRingSamples)
+        {
+            return juce::nextPowerOfTwo(juce::jlimit(kMinSharedMemoryRingSize, kMaxSharedMemoryRingSize, minRingSamples));
+        }
+
+        // One attachment to a segment. Unlocks, unmaps and detaches when destroyed.
+        struct Mapping
+        {
+            Mapping(void* baseToUse, size_t sizeToUse, int pairIDToUse)
+                : base(baseToUse),
+                  size(sizeToUse),
+                  pairID(pairIDToUse),
+                  header(static_cast<SharedMemoryHeader*>(baseToUse)),
+                  ringSize(header->ringSize.load(std::memory_order_acquire))
+            {
+                auto* samples = static_cast<char*>(baseToUse) + kSamplesOffset;
+                auto* scales = reinterpret_cast<float*>(static_cast<char*>(baseToUse) + getScalesOffset(ringSize));
+
+                for (auto format : { RingFormat::Float32, RingFormat::Float16, RingFormat::ScaledInt16 })
+                    rings[static_cast<size_t>(format)] = std::make_unique<RingStorage>(samples, scales, ringSize, kMaxChannels, format);
+            }
+
+            ~Mapping()
+            {
+               #if GAINSTAGE_HAS_POSIX_SHM
+                ringLock.release();
+                scalesLock.release();
+                detach(*header, pairID);
+                munmap(base, size);
+               #endif
+            }
+
+            Mapping(const Mapping&) = delete;
+            Mapping& operator=(const Mapping&) = delete;
+
+            // Clamped, since the value comes from memory other processes write.
+            RingFormat getFormat() const
+            {
+                return static_cast<RingFormat>(juce::jlimit(0, static_cast<int>(rings.size()) - 1,
+                                                            static_cast<int>(header->ringFormat.load(std::memory_order_acquire))));
+            }
+
+            RingStorage& getRing(RingFormat format) { return *rings[static_cast<size_t>(format)]; }
+
+            // Keeps the header and the channels this process uses resident. Only the pages of
+            // those channels are locked (and therefore committed); the rest of the segment
+            // stays untouched. The writer can change format at any time, so the lock covers
+            // float-sized channels and their scales, which holds every format. The partner may
+            // already be streaming, so pages are touched by reading, which is enough for a
+            // shared mapping.
+            void lockChannels(int numChannels)
+            {
+                numChannels = juce::jlimit(1, kMaxChannels, numChannels);
+                if (numChannels <= lockedChannels)
+                    return;
+
+                const size_t channelBytes = static_cast<size_t>(ringSize) * sizeof(float);
+                auto* bytes = static_cast<char*>(base);
+
+                ringLock = RealtimeMemory::LockedRegion(bytes, kSamplesOffset + channelBytes * static_cast<size_t>(numChannels), false);
+                scalesLock = RealtimeMemory::LockedRegion(bytes + getScalesOffset(ringSize),
+                                                          sizeof(float) * static_cast<size_t>(ringSize / kScaleChunkSize)
+                                                              * static_cast<size_t>(numChannels),
+                                                          false);
+
+                lockedChannels = numChannels;
+            }
+
+            void* base;
+            size_t size;
+            int pairID;
+            SharedMemoryHeader* header;
+            int ringSize;
+            std::array<std::unique_ptr<RingStorage>, 3> rings;
+            int lockedChannels = 0;
+            RealtimeMemory::LockedRegion ringLock;
+            RealtimeMemory::LockedRegion scalesLock;
+        };
+
+        using MappingAccess = GuardedSlot<Mapping>::ScopedAccess;
+
+        struct PairSlot
+        {
+            std::unique_ptr<Mapping> mapping;
+            int references = 0;
+            // The format this process's writer asked for, applied to the segment once mapped.
+            std::optional<RingFormat> writerFormat;
+        };
+
+        // Unpublished but not yet unmapped; waits for its slot's guard to go idle.
+        struct RetiredMapping
+        {
+            std::unique_ptr<Mapping> mapping;
+            int pairID = 0;
+        };
+
+        SharedMemoryTransport() = default;
+
+        ~SharedMemoryTransport() override
+        {
+            stopTimer();
+        }
+
+        SharedMemoryTransport(const SharedMemoryTransport&) = delete;
+        SharedMemoryTransport& operator=(const SharedMemoryTransport&) = delete;
+
+        // Every audio-thread access goes through the pair's guard. An ID out of range yields
+        // an empty access.
+        MappingAccess access(int pairID, AccessGuard::Side side) const
+        {
+            return { mappings_[static_cast<size_t>(juce::isPositiveAndNotGreaterThan(pairID, kMaxPairIDs) ? pairID : kNoPair)], side };
+        }
+
+        // Under mapMutex_. Returns false while some retired mapping is still in use.
+        bool collectRetired()
+        {
+            retired_.erase(std::remove_if(retired_.begin(), retired_.end(),
+                                          [this](const RetiredMapping& retired)
+                                          {
+                                              return mappings_[static_cast<size_t>(retired.pairID)].getGuard().isIdle();
+                                          }),
+                           retired_.end());
+
+            return retired_.empty();
+        }
+
+        void timerCallback() override
+        {
+            std::lock_guard<std::mutex> lock(mapMutex_);
+
+            if (collectRetired())
+                stopTimer();
+        }
+
+        static std::unique_ptr<Mapping> openSegment(int pairID, int minRingSamples)
+        {
+           #if GAINSTAGE_HAS_POSIX_SHM
+            // Another process may unlink the name between our open and our attach.
+            for (int attempt = 0; attempt < 3; ++attempt)
+            {
+                bool unlinked = false;
+
+                if (auto mapping = tryOpenSegment(pairID, getRingSizeFor(minRingSamples), unlinked))
+                    return mapping;
+
+                if (! unlinked)
+                    break;
+            }
+           #else
+            juce::ignoreUnused(pairID, minRingSamples);
+           #endif
+
+            return nullptr;
+        }
+
+       #if GAINSTAGE_HAS_POSIX_SHM
+        // Whichever process creates the segment (O_EXCL wins) sizes it for its own request,
+        // initialises it and then publishes the magic number; everyone else maps whatever size
+        // it was given and waits briefly for the magic.
+        static std::unique_ptr<Mapping> tryOpenSegment(int pairID, int ringSize, bool& unlinked)
+        {
+            const auto name = getSegmentName(pairID);
+            bool created = true;
+
+            int fd = shm_open(name.toRawUTF8(), O_RDWR | O_CREAT | O_EXCL, 0600);
+            if (fd < 0)
+            {
+                created = false;
+                fd = shm_open(name.toRawUTF8(), O_RDWR, 0600);
+            }
+
+            if (fd < 0)
+                return nullptr;
+
+            size_t size = getSegmentSize(ringSize);
+
+            if (created && ftruncate(fd, static_cast<off_t>(size)) != 0)
+            {
+                close(fd);
+                shm_unlink(name.toRawUTF8());
+                return nullptr;
+            }
+
+            if (! created && ! waitForSegmentSize(fd, size))
+            {
+                close(fd);
+                return nullptr;
+            }
+
+            void* base = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+            close(fd);
+
+            if (base == MAP_FAILED)
+                return nullptr;
+
+            auto* header = static_cast<SharedMemoryHeader*>(base);
+
+            if (created)
+            {
+                new (base) SharedMemoryHeader();
+                header->ringSize.store(ringSize, std::memory_order_relaxed);
+                header->magic.store(SharedMemoryHeader::kMagic, std::memory_order_release);
+            }
+            else if (! waitForMagic(*header) || ! isValidRingSize(header->ringSize.load(), size))
+            {
+                munmap(base, size);
+                return nullptr;
+            }
+
+            if (! attach(*header, unlinked))
+            {
+                munmap(base, size);
+                return nullptr;
+            }
+
+            return std::make_unique<Mapping>(base, size, pairID);
+        }
+
+        // The size a segment's creator recorded has to be one this build could have chosen and
+        // has to match what was mapped; anything else belongs to an incompatible build.
+        static bool isValidRingSize(int ringSize, size_t mappedSize)
+        {
+            return juce::isPowerOfTwo(ringSize)
+                && ringSize >= kMinSharedMemoryRingSize
+                && ringSize <= kMaxSharedMemoryRingSize
+                && getSegmentSize(ringSize) == mappedSize;
+        }
+
+        static bool isProcessAlive(int32_t pid)
+        {
+            return pid == static_cast<int32_t>(getpid()) || kill(pid, 0) == 0 || errno == EPERM;
+        }
+
+        // Serialises attaching, detaching and reaping across processes.
+        static bool lockHeader(SharedMemoryHeader& header)
+        {
+            const auto self = static_cast<int32_t>(getpid());
+
+            for (int attempt = 0; attempt < 1000; ++attempt)
+            {
+                int32_t owner = 0;
+
+                if (header.lockOwner.compare_exchange_strong(owner, self)
+                    || (! isProcessAlive(owner) && header.lockOwner.compare_exchange_strong(owner, self)))
+                    return true;
+
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+
+            return false;
+        }
+
+        static void unlockHeader(SharedMemoryHeader& header)
+        {
+            header.lockOwner.store(0, std::memory_order_release);
+        }
+
+        // Under the header lock. Frees the process entries and reader slots of processes that
+        // died without detaching; returns how many attached processes are still alive.
+        static int reapDeadProcesses(SharedMemoryHeader& header)
+        {
+            int numAlive = 0;
+
+            for (auto& process : header.processes)
+            {
+                const auto pid = process.load();
+
+                if (pid != 0 && isProcessAlive(pid))
+                    ++numAlive;
+                else if (pid != 0)
+                    process.store(0);
+            }
+
+            for (int slot = 0; slot < kMaxReaders; ++slot)
+            {
+                auto& owner = header.readerProcesses[static_cast<size_t>(slot)];
+                const auto pid = owner.load();
+
+                if (pid != 0 && ! isProcessAlive(pid))
+                {
+                    owner.store(0);
+                    header.control.unregisterReader(slot);
+                }
+            }
+
+            return numAlive;
+        }
+
+        // A segment nobody alive is attached to only holds what crashed processes left behind,
+        // so the first process to come back starts it from a clean control block.
+        static bool attach(SharedMemoryHeader& header, bool& unlinked)
+        {
+            if (! lockHeader(header))
+                return false;
+
+            unlinked = header.unlinked.load();
+            bool attached = false;
+
+            if (! unlinked)
+            {
+                if (reapDeadProcesses(header) == 0)
+                {
+                    new (&header.control) PairControl();
+                    header.ringFormat.store(static_cast<int32_t>(RingFormat::Float32));
+                    header.requestedFormat.store(static_cast<int32_t>(RingFormat::Float32));
+
+                    for (auto& owner : header.readerProcesses)
+                        owner.store(0);
+                }
+
+                for (auto& process : header.processes)
+                {
+                    int32_t expected = 0;
+
+                    if (process.compare_exchange_strong(expected, static_cast<int32_t>(getpid())))
+                    {
+                        attached = true;
+                        break;
+                    }
+                }
+            }
+
+            unlockHeader(header);
+            return attached;
+        }
+
+        // The last live process to detach removes the name.
+        static void detach(SharedMemoryHeader& header, int pairID)
+        {
+            if (! lockHeader(header))
+                return;
+
+            // One entry per mapping, so a process still holding another mapping of this
+            // segment stays attached.
+            for (auto& process : header.processes)
+            {
+                auto expected = static_cast<int32_t>(getpid());
+
+                if (process.compare_exchange_strong(expected, 0))
+                    break;
+            }
+
+            if (reapDeadProcesses(header) == 0)
+            {
+                header.unlinked.store(true);
+                shm_unlink(getSegmentName(pairID).toRawUTF8());
+            }
+
+            unlockHeader(header);
+        }
+
+        // Waits for the creator to size the segment and returns that size.
+        static bool waitForSegmentSize(int fd, size_t& size)
+        {
+            for (int attempt = 0; attempt < 200; ++attempt)
+            {
+                struct stat info {};
+                if (fstat(fd, &info) == 0 && info.st_size != 0)
+                {
+                    size = static_cast<size_t>(info.st_size);
+                    return size >= kSamplesOffset;
+                }
+
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+
+            return false;
+        }
+
+        static bool waitForMagic(const SharedMemoryHeader& header)
+        {
+            for (int attempt = 0; attempt < 200; ++attempt)
+            {
+                if (header.magic.load(std::memory_order_acquire) == SharedMemoryHeader::kMagic)
+                    return true;
+
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+
+            return false;
+        }
+       #endif
+
+        // Indexed by pair ID; entry kNoPair never holds a mapping, so invalid IDs resolve to it.
+        mutable std::array<GuardedSlot<Mapping>, kMaxPairIDs + 1> mappings_;
+
+        mutable std::mutex mapMutex_;
+        std::array<PairSlot, kMaxPairIDs> slots_;
+        std::vector<RetiredMapping> retired_;
+    };
+}
@@ -0,0 +1,332 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "SharedBuffer.h"
+
+namespace GainStage
+{
+    constexpr int kMaxTaps = ParamRanges::TAP_INDEX_MAX;
+    // Slots are allocated in blocks of this many as a chain grows.
+    constexpr int kTapBlockSize = 16;
+    constexpr int kMaxTapBlocks = kMaxTaps / kTapBlockSize;
+
+    // One tap's latest levels. Only the owning tap's audio thread stores to the levels and
+    // block count; ordinal is set off the audio thread.
+    struct alignas(kCacheLineSize) TapSlot
+    {
+        std::atomic<bool> inUse{ false };
+        std::atomic<int> ordinal{ 0 };
+        std::atomic<uint64_t> blocks{ 0 };
+        std::atomic<float> rmsdB{ -100.0f };
+        std::atomic<float> peakdB{ -100.0f };
+    };
+
+    // A tap as the chain viewer sees it.
+    struct TapInfo
+    {
+        int slot = -1;
+        int ordinal = 0;
+        uint64_t blocks = 0;
+        float rmsdB = -100.0f;
+        float peakdB = -100.0f;
+    };
+
+    // Every tap instance sharing a chain ID. Taps publish a handful of levels per block and
+    // never any audio, so any number of them can watch one chain for a fixed cost each.
+    // Slot blocks are added as taps join and kept until the chain itself is freed.
+    class TapChain
+    {
+    public:
+        // Off the audio thread, under the registry's lock. Returns the claimed slot, or -1
+        // if all kMaxTaps are taken.
+        int registerTap(int ordinal)
+        {
+            for (int block = 0; block < kMaxTapBlocks; ++block)
+            {
+                auto* taps = blocks_[static_cast<size_t>(block)].load(std::memory_order_acquire);
+
+                if (taps == nullptr)
+                {
+                    ownedBlocks_.push_back(std::make_unique<TapBlock>());
+                    taps = ownedBlocks_.back().get();
+                    blocks_[static_cast<size_t>(block)].store(taps, std::memory_order_release);
+                }
+
+                for (int index = 0; index < kTapBlockSize; ++index)
+                {
+                    bool expected = false;
+                    auto& tap = (*taps)[static_cast<size_t>(index)];
+
+                    if (tap.inUse.compare_exchange_strong(expected, true))
+                    {
+                        tap.ordinal.store(ordinal);
+                        tap.blocks.store(0);
+                        tap.rmsdB.store(-100.0f);
+                        tap.peakdB.store(-100.0f);
+                        return block * kTapBlockSize + index;
+                    }
+                }
+            }
+
+            return -1;
+        }
+
+        void unregisterTap(int slot)
+        {
+            if (auto* tap = getSlot(slot))
+                tap->inUse.store(false);
+        }
+
+        void setOrdinal(int slot, int ordinal)
+        {
+            if (auto* tap = getSlot(slot))
+                tap->ordinal.store(ordinal);
+        }
+
+        // Audio thread, wait-free.
+        void publish(int slot, float rmsdB, float peakdB)
+        {
+            auto* tap = getSlot(slot);
+
+            if (tap == nullptr)
+                return;
+
+            tap->rmsdB.store(rmsdB, std::memory_order_relaxed);
+            tap->peakdB.store(peakdB, std::memory_order_relaxed);
+            tap->blocks.store(tap->blocks.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+        }
+
+        // Registered taps in chain order; taps sharing an ordinal keep slot order.
+        std::vector<TapInfo> getTaps() const
+        {
+            std::vector<TapInfo> taps;
+
+            for (int slot = 0; slot < kMaxTaps; ++slot)
+            {
+                const auto* tap = getSlot(slot);
+
+                if (tap == nullptr)
+                    break;
+
+                if (! tap->inUse.load())
+                    continue;
+
+                TapInfo info;
+                info.slot = slot;
+                info.ordinal = tap->ordinal.load();
+                info.blocks = tap->blocks.load(std::memory_order_acquire);
+                info.rmsdB = tap->rmsdB.load(std::memory_order_relaxed);
+                info.peakdB = tap->peakdB.load(std::memory_order_relaxed);
+                taps.push_back(info);
+            }
+
+            std::stable_sort(taps.begin(), taps.end(),
+                             [](const TapInfo& a, const TapInfo& b) { return a.ordinal < b.ordinal; });
+            return taps;
+        }
+
+    private:
+        using TapBlock = std::array<TapSlot, kTapBlockSize>;
+
+        // Blocks are filled in order, so a missing block means no slot past it exists.
+        TapSlot* getSlot(int slot) const
+        {
+            if (! juce::isPositiveAndBelow(slot, kMaxTaps))
+                return nullptr;
+
+            auto* taps = blocks_[static_cast<size_t>(slot / kTapBlockSize)].load(std::memory_order_acquire);
+            return taps != nullptr ? &(*taps)[static_cast<size_t>(slot % kTapBlockSize)] : nullptr;
+        }
+
+        std::array<std::atomic<TapBlock*>, kMaxTapBlocks> blocks_{};
+        std::vector<std::unique_ptr<TapBlock>> ownedBlocks_;
+    };
+
+    // In-process registry of tap chains, keyed by the same IDs as pairs. Chains are created
+    // when the first tap binds and freed when the last one lets go, once no audio thread is
+    // inside them. Audio threads reach a chain only through its GuardedSlot, like a pair.
+    class TapChainRegistry : private juce::Timer
+    {
+    public:
+        using ChainAccess = GuardedSlot<TapChain>::ScopedAccess;
+
+        static TapChainRegistry& getInstance()
+        {
+            static TapChainRegistry instance;
+            return instance;
+        }
+
+        // Audio thread. Empty for IDs no tap is bound to. A tap re-checks its binding inside
+        // the access: releases clear the binding before waiting for the guard to go idle.
+        ChainAccess access(int chainID) const
+        {
+            return { chains_[static_cast<size_t>(juce::isPositiveAndNotGreaterThan(chainID, kMaxPairIDs) ? chainID : kNoChain)],
+                     AccessGuard::Side::Writer };
+        }
+
+        // Off the audio thread. Empty if no tap is bound to chainID.
+        std::vector<TapInfo> getTaps(int chainID) const
+        {
+            std::lock_guard<std::mutex> lock(registryMutex_);
+
+            if (auto* chain = getOwnedChain(chainID))
+                return chain->getTaps();
+
+            return {};
+        }
+
+        void setOrdinal(int chainID, int tapSlot, int ordinal)
+        {
+            std::lock_guard<std::mutex> lock(registryMutex_);
+
+            if (auto* chain = getOwnedChain(chainID))
+                chain->setOrdinal(tapSlot, ordinal);
+        }
+
+        // Off the audio thread. Returns the tap's slot on the chain, or -1 if it is full.
+        int acquireTap(int chainID, int ordinal)
+        {
+            if (chainID < 1 || chainID > kMaxPairIDs)
+                return -1;
+
+            std::lock_guard<std::mutex> lock(registryMutex_);
+            auto& slot = slots_[chainID - 1];
+
+            if (slot.chain == nullptr)
+            {
+                slot.chain = std::make_unique<TapChain>();
+                chains_[static_cast<size_t>(chainID)].publish(slot.chain.get());
+            }
+
+            const int tapSlot = slot.chain->registerTap(ordinal);
+
+            if (tapSlot >= 0)
+                ++slot.references;
+            else if (slot.references == 0)
+                retire(chainID);
+
+            collectRetired();
+            return tapSlot;
+        }
+
+        // Off the audio thread, after the tap's binding has been cleared. The tap's slot is
+        // only handed out again once no audio thread can still be publishing to it.
+        void releaseTap(int chainID, int tapSlot)
+        {
+            if (chainID < 1 || chainID > kMaxPairIDs)
+                return;
+
+            std::lock_guard<std::mutex> lock(registryMutex_);
+            auto& slot = slots_[chainID - 1];
+
+            if (slot.chain != nullptr && tapSlot >= 0)
+            {
+                releasing_.push_back({ chainID, tapSlot });
+
+                if (slot.references > 0 && --slot.references == 0)
+                    retire(chainID);
+            }
+
+            if (! collectRetired())
+                startTimer(kReclaimIntervalMs);
+        }
+
+    private:
+        static constexpr int kReclaimIntervalMs = 100;
+        static constexpr int kNoChain = 0;
+
+        struct ChainSlot
+        {
+            std::unique_ptr<TapChain> chain;
+            int references = 0;
+        };
+
+        // Unpublished but not yet freed; waits for its slot's guard to go idle.
+        struct RetiredChain
+        {
+            std::unique_ptr<TapChain> chain;
+            int chainID = 0;
+        };
+
+        // A released tap whose slot stays claimed until its chain's guard goes idle.
+        struct ReleasingTap
+        {
+            int chainID = 0;
+            int tapSlot = -1;
+        };
+
+        TapChainRegistry() = default;
+
+        ~TapChainRegistry() override
+        {
+            stopTimer();
+        }
+
+        TapChainRegistry(const TapChainRegistry&) = delete;
+        TapChainRegistry& operator=(const TapChainRegistry&) = delete;
+
+        TapChain* getOwnedChain(int chainID) const
+        {
+            return chainID >= 1 && chainID <= kMaxPairIDs ? slots_[chainID - 1].chain.get() : nullptr;
+        }
+
+        void retire(int chainID)
+        {
+            chains_[static_cast<size_t>(chainID)].publish(nullptr);
+            retired_.push_back({ std::move(slots_[chainID - 1].chain), chainID });
+
+            // The whole chain goes, so its releasing taps have nothing left to unregister.
+            releasing_.erase(std::remove_if(releasing_.begin(), releasing_.end(),
+                                            [chainID](const ReleasingTap& tap) { return tap.chainID == chainID; }),
+                             releasing_.end());
+        }
+
+        bool isIdle(int chainID) const
+        {
+            return chains_[static_cast<size_t>(chainID)].getGuard().isIdle();
+        }
+
+        // Returns false while some released tap or retired chain is still waiting.
+        bool collectRetired()
+        {
+            releasing_.erase(std::remove_if(releasing_.begin(), releasing_.end(),
+                                            [this](const ReleasingTap& tap)
+                                            {
+                                                if (! isIdle(tap.chainID))
+                                                    return false;
+
+                                                slots_[tap.chainID - 1].chain->unregisterTap(tap.tapSlot);
+                                                return true;
+                                            }),
+                             releasing_.end());
+
+            retired_.erase(std::remove_if(retired_.begin(), retired_.end(),
+                                          [this](const RetiredChain& chain) { return isIdle(chain.chainID); }),
+                           retired_.end());
+
+            return releasing_.empty() && retired_.empty();
+        }
+
+        void timerCallback() override
+        {
+            std::lock_guard<std::mutex> lock(registryMutex_);
+
+            if (collectRetired())
+                stopTimer();
+        }
+
+        // Indexed by chain ID; entry kNoChain never holds a chain, so invalid IDs resolve to it.
+        mutable std::array<GuardedSlot<TapChain>, kMaxPairIDs + 1> chains_;
+
+        mutable std::mutex registryMutex_;
+        std::array<ChainSlot, kMaxPairIDs> slots_;
+        std::vector<ReleasingTap> releasing_;
+        std::vector<RetiredChain> retired_;
+    };
+}
@@ -0,0 +1,350 @@
+#include <JuceHeader.h>
+#include "../Source/GainAnalyzer.h"
+#include "../Source/Parameters.h"
+
+namespace GainStage
+{
+    // Checks GainAnalyzer's incremental window, binned history and exponential detector
+    // against levels summed from scratch, and the dispatched level kernels against the
+    // portable ones.
+    class GainAnalyzerTests : public juce::UnitTest
+    {
+    public:
+        GainAnalyzerTests() : juce::UnitTest("GainAnalyzer", "GainStage") {}
+
+        void runTest() override
+        {
+            beginTest("The running sum matches a brute-force window over a long run");
+            {
+                GainAnalyzer analyzer;
+                analyzer.prepare(kSampleRate, kMaxBlockSize, 2);
+                analyzer.setRMSWindowSamples(14400);
+
+                Signal signal(2, 20 * kSampleRate, 0x1001);
+                signal.addBursts(1.0f);
+
+                expectLessOrEqual(runWindow(analyzer, signal, 14400, 0), 1.0e-4);
+            }
+
+            beginTest("A quiet tail after loud input is measured without drift");
+            {
+                GainAnalyzer analyzer;
+                analyzer.prepare(kSampleRate, kMaxBlockSize, 2, kAnalyzerBinSize, kMaxRMSWindowSeconds);
+                analyzer.setRMSWindowSamples(14400);
+
+                // 10 s at full scale, 10 s at -80 dB, then silence.
+                Signal signal(2, 25 * kSampleRate, 0x1002);
+                signal.addNoise(0, 10 * kSampleRate, 1.0f);
+                signal.addNoise(10 * kSampleRate, 20 * kSampleRate, 1.0e-4f);
+
+                expectLessOrEqual(runWindow(analyzer, signal, 14400, 0, -1, 10 * kSampleRate + 14400), 1.0e-4);
+                expectEquals(analyzer.getRMSLevel(), 0.0f, "a window of silence reads exactly zero");
+            }
+
+            beginTest("Window changes re-sum the shared binned history");
+            {
+                GainAnalyzer analyzer;
+                analyzer.prepare(kSampleRate, kMaxBlockSize, 2, kAnalyzerBinSize, kMaxRMSWindowSeconds);
+
+                Signal signal(2, 30 * kSampleRate, 0x1003);
+                signal.addBursts(0.5f);
+
+                int64_t position = 0;
+                for (int window : { 2400, 14400, 4800, 48000, 144000, 4800 })
+                {
+                    analyzer.setRMSWindowSamples(window);
+                    expectLessOrEqual(runWindow(analyzer, signal, window, position, 4 * kSampleRate), 1.0e-4);
+                    position += 4 * kSampleRate;
+                }
+
+                analyzer.setRMSWindowSamples(4810);
+                expectEquals(analyzer.getRMSWindowSamples(), 4800, "windows round to whole bins");
+            }
+
+            beginTest("Binned history matches a brute-force 3 s window");
+            {
+                GainAnalyzer analyzer;
+                analyzer.prepare(kSampleRate, kMaxBlockSize, 2, kAnalyzerBinSize, kMaxRMSWindowSeconds);
+                analyzer.setRMSWindowSamples(144000);
+
+                expectEquals(analyzer.getHistorySize(), 144000 / kAnalyzerBinSize + 1);
+
+                Signal signal(2, 8 * kSampleRate, 0x1004);
+                signal.addBursts(1.0f);
+
+                expectLessOrEqual(runWindow(analyzer, signal, 144000, 0), 1.0e-4);
+            }
+
+            beginTest("Channels keep their own windows whatever the channel count");
+            {
+                GainAnalyzer stereo, mono;
+                stereo.prepare(kSampleRate, kMaxBlockSize, 2);
+                mono.prepare(kSampleRate, kMaxBlockSize, 1);
+                stereo.setRMSWindowSamples(4800);
+                mono.setRMSWindowSamples(4800);
+
+                Signal signal(2, kSampleRate, 0x1005);
+                signal.addNoise(0, kSampleRate, 0.5f, 0);
+                signal.addNoise(0, kSampleRate, 0.05f, 1);
+
+                expectLessOrEqual(runWindow(stereo, signal, 4800, 0), 1.0e-4);
+                runWindow(mono, signal, 4800, 0);
+
+                expectWithinAbsoluteError(mono.getChannelRMSdB(0), stereo.getChannelRMSdB(0), 1.0e-4f);
+                expectWithinAbsoluteError(stereo.getChannelRMSdB(0) - stereo.getChannelRMSdB(1), 20.0f, 0.5f);
+            }
+
+            beginTest("Block statistics give the audio's window when it spans whole blocks");
+            {
+                GainAnalyzer fromAudio, fromStats;
+                fromAudio.prepare(kSampleRate, kMaxBlockSize, 2);
+                fromStats.prepare(kSampleRate, kMaxBlockSize, 2);
+                fromAudio.setRMSWindowSamples(4800);
+                fromStats.setRMSWindowSamples(4800);
+
+                Signal signal(2, 5 * kSampleRate, 0x1006);
+                signal.addBursts(1.0f);
+
+                double worst = 0.0;
+                for (int64_t start = 0; start + 480 <= signal.getLength(); start += 480)
+                {
+                    auto block = signal.getBlock(start, 480);
+                    fromAudio.process(block);
+
+                    std::array<float, 2> sumSquares{}, peaks{};
+                    for (int ch = 0; ch < 2; ++ch)
+                    {
+                        sumSquares[static_cast<size_t>(ch)] = fromAudio.getBlockSumSquares(ch);
+                        peaks[static_cast<size_t>(ch)] = fromAudio.getBlockPeak(ch);
+                    }
+
+                    fromStats.processStats(sumSquares.data(), peaks.data(), 2, 480);
+                    worst = juce::jmax(worst, getErrordB(fromStats.getRMSLevel(), fromAudio.getRMSLevel()));
+                }
+
+                expectLessOrEqual(worst, 1.0e-4);
+            }
+
+            beginTest("The exponential detector follows a per-sample one-pole mean square");
+            {
+                GainAnalyzer analyzer;
+                analyzer.prepare(kSampleRate, kMaxBlockSize, 1);
+                analyzer.setRMSWindowSamples(4800);
+                analyzer.setDetector(GainAnalyzer::Detector::Exponential);
+
+                Signal signal(1, 10 * kSampleRate, 0x1007);
+                signal.addBursts(1.0f);
+
+                const double a = std::exp(-2.0 / 4800.0);
+                double meanSquare = 0.0, worst = 0.0;
+                juce::Random random(0x1008);
+
+                for (int64_t start = 0; start < signal.getLength();)
+                {
+                    const int length = static_cast<int>(juce::jmin<int64_t>(1 + random.nextInt(kMaxBlockSize), signal.getLength() - start));
+                    analyzer.process(signal.getBlock(start, length));
+
+                    for (int i = 0; i < length; ++i)
+                    {
+                        const float sample = signal.get(0, start + i);
+                        meanSquare = a * meanSquare + (1.0 - a) * static_cast<double>(sample * sample);
+                    }
+
+                    worst = juce::jmax(worst, getErrordB(analyzer.getRMSLevel(), std::sqrt(meanSquare)));
+                    start += length;
+                }
+
+                expectLessOrEqual(worst, 1.0e-4);
+            }
+
+            beginTest("Only the Window detector keeps a history");
+            {
+                GainAnalyzer analyzer;
+                analyzer.prepare(kSampleRate, kMaxBlockSize, 2, kAnalyzerBinSize, kMaxRMSWindowSeconds,
+                                 GainAnalyzer::Detector::Exponential);
+
+                expect(! analyzer.hasHistory());
+                expect(! analyzer.setDetector(GainAnalyzer::Detector::Window), "Window waits for a history");
+
+                analyzer.allocateHistory();
+                expect(analyzer.setDetector(GainAnalyzer::Detector::Window));
+                expect(analyzer.setDetector(GainAnalyzer::Detector::Exponential));
+
+                analyzer.releaseHistory();
+                expect(! analyzer.hasHistory());
+            }
+
+            beginTest("Dispatched level kernels match the portable ones");
+            {
+                const auto& kernels = LevelKernels::get();
+                logMessage(juce::String("Level kernels: ") + kernels.name);
+
+                Signal signal(2, 256, 0x1009);
+                signal.addNoise(0, 256, 1.0f);
+                std::vector<float> weights(256), squares(256), expectedSquares(256), dest(256), expectedDest(256);
+                for (size_t i = 0; i < weights.size(); ++i)
+                    weights[i] = static_cast<float>(i + 1) / 256.0f;
+
+                bool peaksMatch = true, squaresMatch = true, differencesMatch = true;
+                double worstSum = 0.0;
+
+                // Every length through a few vector widths, from aligned and unaligned starts.
+                for (int offset = 0; offset < 4; ++offset)
+                {
+                    for (int length = 0; length <= 160; ++length)
+                    {
+                        const float* src = signal.getChannel(0) + offset;
+                        const float* other = signal.getChannel(1) + offset;
+                        const float* w = weights.data() + offset;
+
+                        const auto stored = kernels.storeSquares(src, squares.data(), length);
+                        const auto expected = LevelKernels::Scalar::storeSquares(src, expectedSquares.data(), length);
+                        const auto measured = kernels.measure(src, length);
+
+                        peaksMatch = peaksMatch && stored.peak == expected.peak && measured.peak == expected.peak
+                                     && kernels.peak(src, length) == expected.peak;
+                        squaresMatch = squaresMatch && std::equal(squares.begin(), squares.begin() + length, expectedSquares.begin());
+
+                        worstSum = juce::jmax(worstSum,
+                                              getRelativeError(stored.sumSquares, expected.sumSquares),
+                                              getRelativeError(measured.sumSquares, expected.sumSquares),
+                                              getRelativeError(kernels.sum(src, length), LevelKernels::Scalar::sum(src, length)));
+                        worstSum = juce::jmax(worstSum, getRelativeError(kernels.weightedSumSquares(src, w, length),
+                                                                         LevelKernels::Scalar::weightedSumSquares(src, w, length)));
+
+                        kernels.difference(src, other, 0.7f, dest.data(), length);
+                        LevelKernels::Scalar::difference(src, other, 0.7f, expectedDest.data(), length);
+                        for (int i = 0; i < length; ++i)
+                            differencesMatch = differencesMatch && std::abs(dest[static_cast<size_t>(i)] - expectedDest[static_cast<size_t>(i)]) <= 1.0e-6f;
+                    }
+                }
+
+                expect(peaksMatch, "peaks agree exactly");
+                expect(squaresMatch, "stored squares agree bit for bit");
+                expect(differencesMatch, "differences agree to within rounding");
+                expectLessOrEqual(worstSum, 1.0e-12);
+            }
+        }
+
+    private:
+        static constexpr int kSampleRate = 48000;
+        static constexpr int kMaxBlockSize = 512;
+
+        // Multichannel test audio, generated up front so the expected levels can be summed
+        // from it.
+        class Signal
+        {
+        public:
+            Signal(int numChannels, int64_t length, int seed)
+                : samples_(static_cast<size_t>(numChannels), std::vector<float>(static_cast<size_t>(length))), random_(seed)
+            {
+            }
+
+            int64_t getLength() const { return static_cast<int64_t>(samples_[0].size()); }
+            int getNumChannels() const { return static_cast<int>(samples_.size()); }
+            float get(int channel, int64_t position) const { return samples_[static_cast<size_t>(channel)][static_cast<size_t>(position)]; }
+            const float* getChannel(int channel) const { return samples_[static_cast<size_t>(channel)].data(); }
+
+            void addNoise(int64_t start, int64_t end, float gain, int onlyChannel = -1)
+            {
+                for (int ch = 0; ch < getNumChannels(); ++ch)
+                    if (onlyChannel < 0 || ch == onlyChannel)
+                        for (auto i = start; i < end; ++i)
+                            samples_[static_cast<size_t>(ch)][static_cast<size_t>(i)] = gain * (random_.nextFloat() * 2.0f - 1.0f);
+            }
+
+            // Noise bursts of random length and level with silent gaps, so windows keep
+            // swinging between loud and near-empty.
+            void addBursts(float maxGain)
+            {
+                for (int64_t start = 0; start < getLength();)
+                {
+                    const int64_t length = 1000 + random_.nextInt(30000);
+                    const float gain = random_.nextInt(4) == 0 ? 0.0f : maxGain * std::pow(10.0f, -3.0f * random_.nextFloat());
+                    addNoise(start, juce::jmin(start + length, getLength()), gain);
+                    start += length;
+                }
+            }
+
+            // A block referencing the signal's samples.
+            juce::AudioBuffer<float> getBlock(int64_t start, int length)
+            {
+                std::vector<float*> channels;
+                for (auto& channel : samples_)
+                    channels.push_back(channel.data() + start);
+
+                return juce::AudioBuffer<float>(channels.data(), getNumChannels(), length);
+            }
+
+            // Energy of channel in [begin, end), summed sample by sample, with silence before
+            // the signal starts.
+            double getEnergy(int channel, int64_t begin, int64_t end) const
+            {
+                double energy = 0.0;
+                for (auto i = juce::jmax<int64_t>(0, begin); i < end; ++i)
+                    energy += static_cast<double>(get(channel, i) * get(channel, i));
+
+                return energy;
+            }
+
+        private:
+            std::vector<std::vector<float>> samples_;
+            juce::Random random_;
+        };
+
+        // Feeds length samples of the signal from start in random block sizes, and returns the
+        // worst difference in dB between the analyzer's per-channel levels and the window summed
+        // from scratch, over the blocks ending at or after checkFrom. The analyzer must have seen
+        // the signal up to start; binned, the window also spans the bin still filling.
+        double runWindow(GainAnalyzer& analyzer, const Signal& signal, int windowSamples, int64_t start,
+                         int64_t length = -1, int64_t checkFrom = 0)
+        {
+            juce::Random random(static_cast<int>(start) + windowSamples);
+            const int64_t end = length < 0 ? signal.getLength() : juce::jmin(signal.getLength(), start + length);
+            const int numChannels = juce::jmin(analyzer.getNumChannels(), signal.getNumChannels());
+            const int binSize = analyzer.getBinSize();
+            double worst = 0.0;
+
+            for (auto position = start; position < end;)
+            {
+                const int blockLength = static_cast<int>(juce::jmin<int64_t>(1 + random.nextInt(kMaxBlockSize), end - position));
+                std::vector<const float*> channels;
+                for (int ch = 0; ch < numChannels; ++ch)
+                    channels.push_back(signal.getChannel(ch) + position);
+
+                analyzer.process(channels.data(), channels.data(), numChannels, blockLength, blockLength);
+                position += blockLength;
+
+                if (position < checkFrom)
+                    continue;
+
+                const auto spanned = static_cast<double>(windowSamples + position % binSize);
+
+                for (int ch = 0; ch < numChannels; ++ch)
+                {
+                    const double expected = signal.getEnergy(ch, position - static_cast<int64_t>(spanned), position);
+                    worst = juce::jmax(worst, getErrordB(analyzer.getChannelRMSLevel(ch), std::sqrt(expected / spanned)));
+                }
+            }
+
+            return worst;
+        }
+
+        // Levels below -120 dB count as silence on both sides.
+        static double getErrordB(double level, double expected)
+        {
+            constexpr double kSilence = 1.0e-6;
+            if (level < kSilence && expected < kSilence)
+                return 0.0;
+
+            return std::abs(20.0 * std::log10(juce::jmax(level, kSilence) / juce::jmax(expected, kSilence)));
+        }
+
+        static double getRelativeError(double value, double expected)
+        {
+            return expected == 0.0 ? std::abs(value) : std::abs(value - expected) / std::abs(expected);
+        }
+    };
+
+    static GainAnalyzerTests gainAnalyzerTests;
+}
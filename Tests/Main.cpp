@@ -0,0 +1,18 @@
+#include <JuceHeader.h>
+
+// Runs every GainStage unit test and exits non-zero if any check failed.
+int main(int argc, char* argv[])
+{
+    juce::ignoreUnused(argc, argv);
+    juce::ScopedJuceInitialiser_GUI juceInitialiser;
+
+    juce::UnitTestRunner runner;
+    runner.setAssertOnFailure(false);
+    runner.runTestsInCategory("GainStage");
+
+    int numFailures = 0;
+    for (int i = 0; i < runner.getNumResults(); ++i)
+        numFailures += runner.getResult(i)->failures;
+
+    return numFailures > 0 ? 1 : 0;
+}
@@ -0,0 +1,159 @@
+#include <JuceHeader.h>
+#include "../Source/SharedBuffer.h"
+
+namespace GainStage
+{
+    // Pins down what the reduced-precision ring formats cost in measured level, using the
+    // same RingStorage path the pairs use, and checks the CPU-specific converters against
+    // the portable ones.
+    class SampleFormatTests : public juce::UnitTest
+    {
+    public:
+        SampleFormatTests() : juce::UnitTest("SampleFormat", "GainStage") {}
+
+        void runTest() override
+        {
+            beginTest("Float16 keeps every sample within 2^-11 and levels within 0.004 dB");
+            {
+                for (float leveldB : { 0.0f, -20.0f, -60.0f, -80.0f })
+                {
+                    const auto input = makeNoise(juce::Decibels::decibelsToGain(leveldB));
+                    const auto output = roundTrip(RingFormat::Float16, input);
+
+                    // Below 2^-14 halves are subnormal and only keep absolute precision.
+                    float worstRelative = 0.0f;
+                    for (size_t i = 0; i < input.size(); ++i)
+                        if (std::abs(input[i]) >= 6.103515625e-05f)
+                            worstRelative = juce::jmax(worstRelative, std::abs(output[i] - input[i]) / std::abs(input[i]));
+
+                    expectLessOrEqual(worstRelative, 1.0f / 2048.0f);
+                    expectLessOrEqual(std::abs(getRMSdB(output) - getRMSdB(input)), 0.004f);
+                }
+            }
+
+            beginTest("ScaledInt16 stays within one step of each chunk's peak");
+            {
+                // Blocks that straddle chunks with a rising level, so chunks get rescaled.
+                std::vector<float> input(kNumSamples);
+                for (int i = 0; i < kNumSamples; ++i)
+                    input[static_cast<size_t>(i)] = std::sin(0.05f * static_cast<float>(i))
+                                                  * static_cast<float>(i + 1) / static_cast<float>(kNumSamples);
+
+                const auto output = roundTrip(RingFormat::ScaledInt16, input, 100);
+
+                bool withinStep = true;
+                for (int chunk = 0; chunk < kNumSamples / kScaleChunkSize; ++chunk)
+                {
+                    const auto* in = input.data() + chunk * kScaleChunkSize;
+                    const auto* out = output.data() + chunk * kScaleChunkSize;
+                    const auto range = juce::FloatVectorOperations::findMinAndMax(in, kScaleChunkSize);
+                    const float step = juce::jmax(-range.getStart(), range.getEnd()) / 32767.0f;
+
+                    for (int i = 0; i < kScaleChunkSize; ++i)
+                        withinStep = withinStep && std::abs(out[i] - in[i]) <= step * 1.001f;
+                }
+
+                expect(withinStep, "every sample within one step of its chunk's peak / 32767");
+            }
+
+            beginTest("ScaledInt16 measures quiet material next to a loud peak exactly");
+            {
+                // -40 dB tone with a full-scale click at the start of every chunk.
+                auto input = makeNoise(0.01f);
+                for (size_t i = 0; i < input.size(); i += kScaleChunkSize)
+                    input[i] = 1.0f;
+
+                const auto output = roundTrip(RingFormat::ScaledInt16, input);
+
+                std::vector<float> quietIn, quietOut;
+                for (size_t i = 0; i < input.size(); ++i)
+                {
+                    if (i % kScaleChunkSize != 0)
+                    {
+                        quietIn.push_back(input[i]);
+                        quietOut.push_back(output[i]);
+                    }
+                }
+
+                expectLessOrEqual(std::abs(getRMSdB(quietOut) - getRMSdB(quietIn)), 0.01f);
+            }
+
+            beginTest("Dispatched half converters match the portable ones");
+            {
+                const auto& converters = SampleConversion::getHalfConverters();
+                logMessage(juce::String("Half converters: ") + converters.name);
+
+                auto input = makeNoise(1.0f);
+                for (float special : { 0.0f, -0.0f, 1.0e-7f, 6.0e-8f, 3.0e-5f, 6.1035e-5f, 65504.0f, 65520.0f, 1.0e9f,
+                                       std::numeric_limits<float>::infinity(), -std::numeric_limits<float>::infinity(),
+                                       1.0f + 1.0f / 2048.0f, 1.0f + 3.0f / 2048.0f })
+                    input.push_back(special);
+
+                const int numInputs = static_cast<int>(input.size());
+                std::vector<uint16_t> dispatched(input.size()), portable(input.size());
+                converters.floatToHalf(input.data(), dispatched.data(), numInputs);
+                SampleConversion::Scalar::floatToHalf(input.data(), portable.data(), numInputs);
+                expect(dispatched == portable, "float -> half agrees bit for bit");
+
+                std::vector<uint16_t> halves(65536);
+                for (size_t i = 0; i < halves.size(); ++i)
+                    halves[i] = static_cast<uint16_t>(i);
+
+                std::vector<float> fromDispatched(halves.size()), fromPortable(halves.size());
+                converters.halfToFloat(halves.data(), fromDispatched.data(), 65536);
+                SampleConversion::Scalar::halfToFloat(halves.data(), fromPortable.data(), 65536);
+
+                // Hardware quietens signalling NaNs, so NaNs only need to stay NaNs.
+                bool agree = true;
+                for (size_t i = 0; i < halves.size(); ++i)
+                {
+                    if (std::isnan(fromPortable[i]))
+                        agree = agree && std::isnan(fromDispatched[i]);
+                    else
+                        agree = agree && std::memcmp(&fromDispatched[i], &fromPortable[i], sizeof(float)) == 0;
+                }
+
+                expect(agree, "half -> float agrees for every half value");
+            }
+        }
+
+    private:
+        static constexpr int kNumSamples = 8192;
+
+        static std::vector<float> makeNoise(float gain)
+        {
+            juce::Random random(0x5eed);
+            std::vector<float> samples(kNumSamples);
+
+            for (auto& sample : samples)
+                sample = gain * (random.nextFloat() * 2.0f - 1.0f);
+
+            return samples;
+        }
+
+        // Writes input through a one-channel ring in blocks of blockSize, then reads it back.
+        static std::vector<float> roundTrip(RingFormat format, const std::vector<float>& input, int blockSize = 512)
+        {
+            RingStorage ring(kNumSamples, 1, format);
+            const int numSamples = static_cast<int>(input.size());
+
+            for (int start = 0; start < numSamples; start += blockSize)
+                ring.copyToRing(0, static_cast<uint64_t>(start), input.data() + start, juce::jmin(blockSize, numSamples - start));
+
+            std::vector<float> output(input.size());
+            ring.copyFromRing(0, output.data(), 0, numSamples);
+            return output;
+        }
+
+        static float getRMSdB(const std::vector<float>& samples)
+        {
+            double sumSquares = 0.0;
+            for (auto sample : samples)
+                sumSquares += static_cast<double>(sample) * sample;
+
+            return static_cast<float>(10.0 * std::log10(sumSquares / static_cast<double>(samples.size())));
+        }
+    };
+
+    static SampleFormatTests sampleFormatTests;
+}
@@ -0,0 +1,338 @@
+#include <JuceHeader.h>
+#include "../Source/SharedMemoryTransport.h"
+
+#if GAINSTAGE_HAS_POSIX_SHM
+
+#include <poll.h>
+#include <sys/wait.h>
+
+namespace GainStage
+{
+    // Runs both ends of a pair in separate processes: the test process and a forked child,
+    // each attaching to the segment through its own SharedMemoryTransport. Children report
+    // through their exit status and never return into the test runner.
+    class SharedMemoryTransportTests : public juce::UnitTest
+    {
+    public:
+        SharedMemoryTransportTests() : juce::UnitTest("SharedMemoryTransport", "GainStage") {}
+
+        void runTest() override
+        {
+            for (int pairID : { kWritePairID, kCrashedReaderPairID, kOrphanPairID, kFormatPairID, kSizePairID })
+                shm_unlink(SharedMemoryTransport::getSegmentName(pairID).toRawUTF8());
+
+            auto& transport = SharedMemoryTransport::getInstance();
+
+            beginTest("Audio and stats written in one process are read in another");
+            {
+                Signal childAttached, parentReady, childWritten, childMayExit;
+
+                const auto child = spawn([&]
+                {
+                    auto& childTransport = SharedMemoryTransport::getInstance();
+                    childTransport.acquirePair(kWritePairID);
+                    childTransport.prepareBuffer(kWritePairID, 2, kBlockSize * kNumBlocks);
+                    childAttached.post();
+
+                    if (! parentReady.wait())
+                        return false;
+
+                    juce::AudioBuffer<float> block(2, kBlockSize);
+
+                    for (int b = 0; b < kNumBlocks; ++b)
+                    {
+                        for (int i = 0; i < kBlockSize; ++i)
+                        {
+                            const auto value = static_cast<float>(b * kBlockSize + i);
+                            block.setSample(0, i, value);
+                            block.setSample(1, i, -value);
+                        }
+
+                        childTransport.writeSamples(kWritePairID, block, kBlockSize);
+
+                        BlockStats stats;
+                        stats.numSamples = kBlockSize;
+                        stats.numChannels = 2;
+                        stats.sumSquares[0] = static_cast<float>(b);
+                        childTransport.writeStats(kWritePairID, stats);
+                    }
+
+                    childWritten.post();
+                    return childMayExit.wait();
+                });
+
+                expect(childAttached.wait(), "child attached");
+                transport.acquirePair(kWritePairID);
+                transport.prepareBuffer(kWritePairID, 2, kBlockSize * kNumBlocks);
+                expectEquals(transport.getAttachedProcessCount(kWritePairID), 2);
+
+                const int slot = transport.registerReader(kWritePairID);
+                expectGreaterOrEqual(slot, 0);
+                transport.setReaderNeedsAudio(kWritePairID, slot, true);
+                parentReady.post();
+                expect(childWritten.wait(), "child wrote its blocks");
+
+                juce::AudioBuffer<float> dest(2, kBlockSize);
+                expect(transport.readSamples(kWritePairID, dest, kBlockSize, 0, kNoTimelinePosition, slot));
+
+                bool samplesMatch = true;
+                for (int i = 0; i < kBlockSize; ++i)
+                {
+                    const auto expected = static_cast<float>((kNumBlocks - 1) * kBlockSize + i);
+                    samplesMatch = samplesMatch && dest.getSample(0, i) == expected && dest.getSample(1, i) == -expected;
+                }
+                expect(samplesMatch, "last block arrives intact");
+
+                BlockStats stats;
+                expect(transport.readStats(kWritePairID, slot, 0, stats));
+                expectEquals(stats.numSamples, kBlockSize * kNumBlocks);
+                expectEquals(stats.sumSquares[0], static_cast<float>(kNumBlocks * (kNumBlocks - 1) / 2));
+                expect(! transport.readStats(kWritePairID, slot, 0, stats), "stats are consumed once");
+                expectEquals(transport.getWriterBlockCount(kWritePairID), static_cast<uint64_t>(kNumBlocks));
+
+                WriterLiveness liveness;
+                liveness.setTimeoutSamples(kBlockSize * 4);
+                expect(liveness.update(transport.getWriterBlockCount(kWritePairID),
+                                       transport.isBeforeInstanceActive(kWritePairID), kBlockSize));
+
+                childMayExit.post();
+                expectEquals(join(child), 0);
+                expectEquals(transport.getAttachedProcessCount(kWritePairID), 1);
+
+                bool alive = true;
+                for (int b = 0; b < 8; ++b)
+                    alive = liveness.update(transport.getWriterBlockCount(kWritePairID),
+                                            transport.isBeforeInstanceActive(kWritePairID), kBlockSize);
+                expect(! alive, "writer times out once its process is gone");
+
+                transport.unregisterReader(kWritePairID, slot);
+                transport.releasePair(kWritePairID);
+                expect(! segmentExists(kWritePairID), "the last release removes the segment");
+            }
+
+            beginTest("Reader slots held by a crashed process are reclaimed");
+            {
+                Signal childRegistered;
+
+                const auto child = spawn([&]
+                {
+                    auto& childTransport = SharedMemoryTransport::getInstance();
+                    childTransport.acquirePair(kCrashedReaderPairID);
+                    childTransport.prepareBuffer(kCrashedReaderPairID, 2, kBlockSize);
+
+                    for (int i = 0; i < kMaxReaders; ++i)
+                        if (childTransport.registerReader(kCrashedReaderPairID) < 0)
+                            return false;
+
+                    childRegistered.post();
+                    pause();
+                    return true;
+                });
+
+                expect(childRegistered.wait(), "child filled every reader slot");
+                transport.acquirePair(kCrashedReaderPairID);
+                transport.prepareBuffer(kCrashedReaderPairID, 2, kBlockSize);
+                expectEquals(transport.getAttachedProcessCount(kCrashedReaderPairID), 2);
+
+                kill(child, SIGKILL);
+                join(child);
+
+                const int slot = transport.registerReader(kCrashedReaderPairID);
+                expectGreaterOrEqual(slot, 0);
+                expectEquals(transport.getAttachedProcessCount(kCrashedReaderPairID), 1);
+                transport.unregisterReader(kCrashedReaderPairID, slot);
+                transport.releasePair(kCrashedReaderPairID);
+            }
+
+            beginTest("A segment left only by crashed processes is reset on attach");
+            {
+                Signal childWrote;
+
+                const auto child = spawn([&]
+                {
+                    auto& childTransport = SharedMemoryTransport::getInstance();
+                    childTransport.acquirePair(kOrphanPairID);
+                    childTransport.prepareBuffer(kOrphanPairID, 2, kBlockSize);
+
+                    if (childTransport.registerReader(kOrphanPairID) < 0)
+                        return false;
+
+                    BlockStats stats;
+                    stats.numSamples = kBlockSize;
+                    stats.numChannels = 2;
+                    childTransport.writeStats(kOrphanPairID, stats);
+                    childWrote.post();
+                    pause();
+                    return true;
+                });
+
+                expect(childWrote.wait(), "child wrote before crashing");
+                kill(child, SIGKILL);
+                join(child);
+
+                transport.acquirePair(kOrphanPairID);
+
+                transport.prepareBuffer(kOrphanPairID, 2, kBlockSize);
+                expectEquals(transport.getAttachedProcessCount(kOrphanPairID), 1);
+                expectEquals(transport.getWriterBlockCount(kOrphanPairID), static_cast<uint64_t>(0));
+                expect(! transport.isBeforeInstanceActive(kOrphanPairID));
+
+                const int slot = transport.registerReader(kOrphanPairID);
+                expectEquals(slot, 0);
+                transport.unregisterReader(kOrphanPairID, slot);
+                transport.releasePair(kOrphanPairID);
+            }
+
+            beginTest("The writer's format applies to a segment a reader mapped first");
+            {
+                Signal parentMapped, childWrote;
+
+                const auto child = spawn([&]
+                {
+                    if (! parentMapped.wait())
+                        return false;
+
+                    auto& childTransport = SharedMemoryTransport::getInstance();
+                    childTransport.setRingFormat(kFormatPairID, RingFormat::Float16);
+                    childTransport.acquirePair(kFormatPairID);
+                    childTransport.prepareBuffer(kFormatPairID, 1, kBlockSize);
+
+                    juce::AudioBuffer<float> block(1, kBlockSize);
+                    for (int i = 0; i < kBlockSize; ++i)
+                        block.setSample(0, i, kThird);
+
+                    childTransport.writeSamples(kFormatPairID, block, kBlockSize);
+                    childWrote.post();
+                    return true;
+                });
+
+                transport.acquirePair(kFormatPairID);
+
+                transport.prepareBuffer(kFormatPairID, 1, kBlockSize);
+                const int slot = transport.registerReader(kFormatPairID);
+                transport.setReaderNeedsAudio(kFormatPairID, slot, true);
+
+                juce::AudioBuffer<float> block(1, kBlockSize);
+                block.clear();
+                transport.writeSamples(kFormatPairID, block, kBlockSize);
+
+                parentMapped.post();
+                expect(childWrote.wait(), "child wrote in Float16");
+                expectEquals(join(child), 0);
+
+                juce::AudioBuffer<float> dest(1, kBlockSize);
+                expect(transport.readSamples(kFormatPairID, dest, kBlockSize, 0, kNoTimelinePosition, slot));
+                expectEquals(dest.getSample(0, 0), SampleConversion::halfToFloat(SampleConversion::floatToHalf(kThird)));
+                expect(dest.getSample(0, 0) != kThird, "samples went through Float16");
+
+                expect(! transport.readSamples(kFormatPairID, dest, kBlockSize, kBlockSize, kNoTimelinePosition, slot),
+                       "samples written before the switch are stale");
+
+                transport.unregisterReader(kFormatPairID, slot);
+                transport.releasePair(kFormatPairID);
+            }
+
+            beginTest("A segment is sized by its creator and clamps bigger requests");
+            {
+                Signal parentMapped;
+                const auto committedBefore = transport.getCommittedBytes();
+
+                const auto child = spawn([&]
+                {
+                    if (! parentMapped.wait())
+                        return false;
+
+                    auto& childTransport = SharedMemoryTransport::getInstance();
+                    childTransport.acquirePair(kSizePairID);
+                    childTransport.prepareBuffer(kSizePairID, 2, 8 * kMinSharedMemoryRingSize);
+                    const bool clamped = childTransport.getRingCapacity(kSizePairID) == 2 * kMinSharedMemoryRingSize;
+                    childTransport.releasePair(kSizePairID);
+                    return clamped;
+                });
+
+                transport.acquirePair(kSizePairID);
+                transport.prepareBuffer(kSizePairID, 2, kMinSharedMemoryRingSize + 1);
+                expectEquals(transport.getRingCapacity(kSizePairID), 2 * kMinSharedMemoryRingSize);
+                expectGreaterThan(transport.getCommittedBytes(), committedBefore);
+
+                parentMapped.post();
+                expectEquals(join(child), 0);
+                expect(segmentExists(kSizePairID), "a partner's release leaves the segment in place");
+                expectEquals(transport.getAttachedProcessCount(kSizePairID), 1);
+
+                transport.releasePair(kSizePairID);
+                expectEquals(transport.getRingCapacity(kSizePairID), 0);
+                expectEquals(transport.getCommittedBytes(), committedBefore);
+                expect(! segmentExists(kSizePairID), "the last release removes the segment");
+            }
+        }
+
+    private:
+        static constexpr int kWritePairID = kMaxPairIDs;
+        static constexpr int kCrashedReaderPairID = kMaxPairIDs - 1;
+        static constexpr int kOrphanPairID = kMaxPairIDs - 2;
+        static constexpr int kFormatPairID = kMaxPairIDs - 3;
+        static constexpr int kSizePairID = kMaxPairIDs - 4;
+        static constexpr float kThird = 1.0f / 3.0f;
+        static constexpr int kBlockSize = 256;
+        static constexpr int kNumBlocks = 64;
+
+        // One-shot cross-process event over a pipe; waits time out so a dead partner fails
+        // the test instead of hanging it.
+        struct Signal
+        {
+            Signal()
+            {
+                const auto result = pipe(fds);
+                jassert(result == 0);
+                juce::ignoreUnused(result);
+            }
+
+            ~Signal() { close(fds[0]); close(fds[1]); }
+
+            void post() { const char byte = 1; juce::ignoreUnused(write(fds[1], &byte, 1)); }
+
+            bool wait()
+            {
+                pollfd request { fds[0], POLLIN, 0 };
+                char byte = 0;
+                return poll(&request, 1, 5000) == 1 && read(fds[0], &byte, 1) == 1;
+            }
+
+            int fds[2] { -1, -1 };
+        };
+
+        static bool segmentExists(int pairID)
+        {
+            const int fd = shm_open(SharedMemoryTransport::getSegmentName(pairID).toRawUTF8(), O_RDWR, 0600);
+
+            if (fd < 0)
+                return false;
+
+            close(fd);
+            return true;
+        }
+
+        template <typename Body>
+        static pid_t spawn(Body&& body)
+        {
+            const auto pid = fork();
+
+            if (pid == 0)
+                _exit(body() ? 0 : 1);
+
+            return pid;
+        }
+
+        static int join(pid_t pid)
+        {
+            int status = 0;
+            waitpid(pid, &status, 0);
+            return WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+        }
+    };
+
+    static SharedMemoryTransportTests sharedMemoryTransportTests;
+}
+
+#endif